@@ -0,0 +1,26 @@
+CONFIG += c++17 console
+CONFIG -= app_bundle qt
+
+# Coder kernels are compiled straight from the benchmark sources
+INCLUDEPATH += \
+    $$PWD/../DepthStreaming
+
+SOURCES += \
+        ../DepthStreaming/HilbertCoder.cpp \
+        ../DepthStreaming/MortonCoder.cpp \
+        ../DepthStreaming/PackedCoder.cpp \
+        ../DepthStreaming/PhaseCoder.cpp \
+        ../DepthStreaming/SplitCoder.cpp \
+        ../DepthStreaming/TriangleCoder.cpp \
+        main.cpp
+
+HEADERS += \
+    ../DepthStreaming/Algorithm.h \
+    ../DepthStreaming/GetOpt.h \
+    ../DepthStreaming/HilbertCoder.h \
+    ../DepthStreaming/MortonCoder.h \
+    ../DepthStreaming/PackedCoder.h \
+    ../DepthStreaming/PhaseCoder.h \
+    ../DepthStreaming/SplitCoder.h \
+    ../DepthStreaming/TriangleCoder.h \
+    ../DepthStreaming/Vec3.h
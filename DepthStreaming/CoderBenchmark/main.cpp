@@ -0,0 +1,272 @@
+#include <HilbertCoder.h>
+#include <MortonCoder.h>
+#include <SplitCoder.h>
+#include <PhaseCoder.h>
+#include <TriangleCoder.h>
+#include <PackedCoder.h>
+#include <GetOpt.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+using namespace DStream;
+using namespace std;
+
+// Written by the kernels so the compiler can't drop the loops under test
+volatile uint32_t g_Sink;
+
+void Usage()
+{
+    cerr <<
+    R"use(Usage: coderbenchmark [OPTIONS]
+
+    Times ValueToColor, ColorToValue, Encode, Decode, EncodeRgbx and DecodeRgbx of every coder in isolation
+      -a <algorithm>: only benchmark this coder (PACKED,TRIANGLE,MORTON,HILBERT,PHASE,SPLIT)
+      -s <list>: comma separated image sides in pixels (default 64,512,2048,4096: L1, L2, L3 and DRAM sized inputs)
+      -r <repetitions>: maximum measured repetitions per case (default 10, at least 3 are always run)
+      -w <warmup>: warmup runs per case (default 1)
+      -t <seconds>: time budget per case after which no more repetitions are started (default 1)
+      -o <file>: also write the results as CSV
+      -?: display this message
+
+    )use";
+}
+
+enum Distribution { SMOOTH = 0, NOISY, RANDOM, DISTRIBUTION_COUNT };
+
+const char* DistributionName(Distribution d)
+{
+    switch (d)
+    {
+    case SMOOTH: return "Smooth";
+    case NOISY: return "Noisy";
+    case RANDOM: return "Random";
+    default: return "Unknown";
+    }
+}
+
+// Smooth: diagonal ramp over the whole range. Noisy: the same ramp with gaussian sensor noise. Random: uniform values.
+vector<uint16_t> GenerateData(uint32_t side, Distribution distribution)
+{
+    vector<uint16_t> ret(side * side);
+    mt19937 rng(side * 31 + distribution);
+    normal_distribution<float> noise(0.0f, 200.0f);
+    uniform_int_distribution<int> uniform(0, 65535);
+
+    for (uint32_t y=0; y<side; y++)
+    {
+        for (uint32_t x=0; x<side; x++)
+        {
+            float ramp = 65535.0f * (x + y) / (2.0f * std::max(1u, side - 1));
+            float val = ramp;
+            if (distribution == NOISY)
+                val += noise(rng);
+            else if (distribution == RANDOM)
+                val = uniform(rng);
+            ret[x + y*side] = std::min(std::max(val, 0.0f), 65535.0f);
+        }
+    }
+
+    return ret;
+}
+
+struct Stats
+{
+    double MinNs;
+    double MedianNs;
+    double MeanNs;
+    double StdDevNs;
+    uint32_t Repetitions;
+};
+
+template <typename Kernel>
+Stats Measure(Kernel kernel, uint32_t warmup, uint32_t maxRepetitions, double budgetSeconds)
+{
+    vector<double> samples;
+
+    for (uint32_t i=0; i<warmup; i++)
+        kernel();
+
+    auto start = chrono::steady_clock::now();
+    while (samples.size() < maxRepetitions)
+    {
+        auto t0 = chrono::steady_clock::now();
+        kernel();
+        auto t1 = chrono::steady_clock::now();
+        samples.push_back(chrono::duration<double, nano>(t1 - t0).count());
+
+        if (samples.size() >= 3 && chrono::duration<double>(t1 - start).count() > budgetSeconds)
+            break;
+    }
+
+    Stats ret;
+    sort(samples.begin(), samples.end());
+    ret.Repetitions = samples.size();
+    ret.MinNs = samples.front();
+    ret.MedianNs = samples.size() % 2 ? samples[samples.size() / 2] : (samples[samples.size() / 2 - 1] + samples[samples.size() / 2]) / 2.0;
+    ret.MeanNs = accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+
+    double var = 0.0;
+    for (double s : samples)
+        var += (s - ret.MeanNs) * (s - ret.MeanNs);
+    ret.StdDevNs = std::sqrt(var / samples.size());
+
+    return ret;
+}
+
+struct BenchmarkConfig
+{
+    vector<uint32_t> Sides = {64, 512, 2048, 4096};
+    uint32_t Warmup = 1;
+    uint32_t Repetitions = 10;
+    double BudgetSeconds = 1.0;
+};
+
+void Report(ostream* csv, const string& coder, const char* kernel, uint32_t side, Distribution distribution, const Stats& stats)
+{
+    double pixels = (double)side * side;
+    cout << coder << "\t" << kernel << "\t" << side << "x" << side << "\t" << DistributionName(distribution) << "\t"
+         << stats.MedianNs / pixels << " ns/px (min " << stats.MinNs / pixels << ", mean " << stats.MeanNs / pixels
+         << ", sd " << stats.StdDevNs / pixels << ", n=" << stats.Repetitions << ")\t"
+         << pixels * 1e3 / stats.MedianNs << " Mpix/s" << endl;
+
+    if (csv)
+        *csv << coder << "," << kernel << "," << side << "," << DistributionName(distribution) << "," << stats.Repetitions << ","
+             << stats.MinNs << "," << stats.MedianNs << "," << stats.MeanNs << "," << stats.StdDevNs << ","
+             << stats.MedianNs / pixels << "," << pixels * 1e3 / stats.MedianNs << endl;
+}
+
+template <typename Coder>
+void BenchmarkCoder(const string& name, Coder& coder, const BenchmarkConfig& config, ostream* csv)
+{
+    for (uint32_t side : config.Sides)
+    {
+        uint32_t count = side * side;
+        for (uint32_t d=0; d<DISTRIBUTION_COUNT; d++)
+        {
+            Distribution distribution = (Distribution)d;
+            vector<uint16_t> values = GenerateData(side, distribution);
+            vector<uint8_t> colors(count * 3);
+            vector<uint32_t> rgbx(count);
+            vector<uint16_t> decoded(count);
+
+            coder.Encode(values.data(), colors.data(), count);
+            coder.EncodeRgbx(values.data(), rgbx.data(), count);
+
+            Stats valueToColor = Measure([&]() {
+                uint32_t acc = 0;
+                for (uint32_t i=0; i<count; i++)
+                {
+                    Color c = coder.ValueToColor(values[i]);
+                    acc += c.x + c.y + c.z;
+                }
+                g_Sink = acc;
+            }, config.Warmup, config.Repetitions, config.BudgetSeconds);
+            Report(csv, name, "ValueToColor", side, distribution, valueToColor);
+
+            Stats colorToValue = Measure([&]() {
+                uint32_t acc = 0;
+                for (uint32_t i=0; i<count; i++)
+                {
+                    Color c = {colors[i*3], colors[i*3+1], colors[i*3+2]};
+                    acc += coder.ColorToValue(c);
+                }
+                g_Sink = acc;
+            }, config.Warmup, config.Repetitions, config.BudgetSeconds);
+            Report(csv, name, "ColorToValue", side, distribution, colorToValue);
+
+            Stats encode = Measure([&]() {
+                coder.Encode(values.data(), colors.data(), count);
+                g_Sink = colors[count / 2];
+            }, config.Warmup, config.Repetitions, config.BudgetSeconds);
+            Report(csv, name, "Encode", side, distribution, encode);
+
+            Stats decode = Measure([&]() {
+                coder.Decode(colors.data(), decoded.data(), count);
+                g_Sink = decoded[count / 2];
+            }, config.Warmup, config.Repetitions, config.BudgetSeconds);
+            Report(csv, name, "Decode", side, distribution, decode);
+
+            Stats encodeRgbx = Measure([&]() {
+                coder.EncodeRgbx(values.data(), rgbx.data(), count);
+                g_Sink = rgbx[count / 2];
+            }, config.Warmup, config.Repetitions, config.BudgetSeconds);
+            Report(csv, name, "EncodeRgbx", side, distribution, encodeRgbx);
+
+            Stats decodeRgbx = Measure([&]() {
+                coder.DecodeRgbx(rgbx.data(), decoded.data(), count);
+                g_Sink = decoded[count / 2];
+            }, config.Warmup, config.Repetitions, config.BudgetSeconds);
+            Report(csv, name, "DecodeRgbx", side, distribution, decodeRgbx);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    BenchmarkConfig config;
+    string algo = "", csvPath = "";
+    int c;
+
+    while ((c = getopt(argc, argv, "a:s:r:w:t:o:")) != -1) {
+        switch (c) {
+        case 'a': algo = optarg; break;
+        case 's': config.Sides = ParseList(optarg); break;
+        case 'r': config.Repetitions = std::max(1, atoi(optarg)); break;
+        case 'w': config.Warmup = atoi(optarg); break;
+        case 't': config.BudgetSeconds = atof(optarg); break;
+        case 'o': csvPath = optarg; break;
+        default: Usage(); return -1;
+        }
+    }
+
+    ofstream csvFile;
+    ostream* csv = nullptr;
+    if (csvPath.compare(""))
+    {
+        csvFile.open(csvPath, ios::out);
+        csvFile << "Coder,Kernel,Side,Distribution,Repetitions,MinNs,MedianNs,MeanNs,StdDevNs,NsPerPixel,Mpixps" << endl;
+        csv = &csvFile;
+    }
+
+    if (!algo.compare("") || !algo.compare("PACKED"))
+    {
+        PackedCoder coder(16);
+        BenchmarkCoder("PACKED", coder, config, csv);
+    }
+    if (!algo.compare("") || !algo.compare("TRIANGLE"))
+    {
+        TriangleCoder coder(16);
+        BenchmarkCoder("TRIANGLE", coder, config, csv);
+    }
+    if (!algo.compare("") || !algo.compare("MORTON"))
+    {
+        MortonCoder coder(16, 6);
+        BenchmarkCoder("MORTON", coder, config, csv);
+    }
+    if (!algo.compare("") || !algo.compare("HILBERT"))
+    {
+        HilbertCoder coder(14, 3);
+        BenchmarkCoder("HILBERT", coder, config, csv);
+    }
+    if (!algo.compare("") || !algo.compare("PHASE"))
+    {
+        PhaseCoder coder(16);
+        BenchmarkCoder("PHASE", coder, config, csv);
+    }
+    if (!algo.compare("") || !algo.compare("SPLIT"))
+    {
+        SplitCoder coder(16);
+        BenchmarkCoder("SPLIT", coder, config, csv);
+    }
+
+    return 0;
+}
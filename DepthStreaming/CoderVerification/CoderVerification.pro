@@ -0,0 +1,31 @@
+CONFIG += c++17 console
+CONFIG -= app_bundle qt
+
+# Coder kernels are compiled straight from the benchmark sources
+INCLUDEPATH += \
+    $$PWD/../DepthStreaming
+
+SOURCES += \
+        ../DepthStreaming/HilbertCoder.cpp \
+        ../DepthStreaming/MedianFilter.cpp \
+        ../DepthStreaming/MortonCoder.cpp \
+        ../DepthStreaming/PackedCoder.cpp \
+        ../DepthStreaming/PhaseCoder.cpp \
+        ../DepthStreaming/SplitCoder.cpp \
+        ../DepthStreaming/ThreadPool.cpp \
+        ../DepthStreaming/TriangleCoder.cpp \
+        main.cpp
+
+HEADERS += \
+    ../DepthStreaming/Algorithm.h \
+    ../DepthStreaming/CoderDispatch.h \
+    ../DepthStreaming/HilbertCoder.h \
+    ../DepthStreaming/MedianFilter.h \
+    ../DepthStreaming/MortonCoder.h \
+    ../DepthStreaming/PackedCoder.h \
+    ../DepthStreaming/PhaseCoder.h \
+    ../DepthStreaming/RgbxLayout.h \
+    ../DepthStreaming/SplitCoder.h \
+    ../DepthStreaming/ThreadPool.h \
+    ../DepthStreaming/TriangleCoder.h \
+    ../DepthStreaming/Vec3.h
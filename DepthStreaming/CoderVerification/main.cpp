@@ -0,0 +1,296 @@
+#include <HilbertCoder.h>
+#include <MortonCoder.h>
+#include <SplitCoder.h>
+#include <PhaseCoder.h>
+#include <TriangleCoder.h>
+#include <PackedCoder.h>
+#include <RgbxLayout.h>
+#include <ThreadPool.h>
+#include <MedianFilter.h>
+#include <CoderDispatch.h>
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+
+using namespace DStream;
+using namespace std;
+
+/** Exhaustive round trip verification of every coder and parameter set.
+ *  - all 65536 depth values go through ValueToColor / ColorToValue, the error is measured against the input quantized
+ *    to the coder precision
+ *  - every colour of the RGB cube (anything JPEG noise can produce) is decoded, and the distance between the colour and
+ *    the re-encoding of its decoded value is reported
+ *  - every Hilbert and Morton configuration accepted by IsValidCoder must round trip exactly
+ *  - the batch Encode / Decode kernels, RGB and RGBX, must match the per-pixel functions exactly: optimized kernels are
+ *    checked here
+ *  - the median post filter must match a plain nth_element median for every window, threshold and band split
+ *
+ *  Exits with a non zero code if a batch kernel or the median filter disagrees with the reference or a lossless coder
+ *  loses precision.
+ */
+
+struct VerifyResult
+{
+    uint32_t MaxErr = 0;
+    uint32_t MaxErrValue = 0;
+    uint64_t SumErr = 0;
+    uint32_t Mismatches = 0;
+    uint32_t MaxColorDistance = 0;
+    bool EncodeConsistent = true;
+    bool DecodeConsistent = true;
+
+    void Merge(const VerifyResult& other)
+    {
+        if (other.MaxErr > MaxErr)
+        {
+            MaxErr = other.MaxErr;
+            MaxErrValue = other.MaxErrValue;
+        }
+        SumErr += other.SumErr;
+        Mismatches += other.Mismatches;
+        MaxColorDistance = std::max(MaxColorDistance, other.MaxColorDistance);
+        EncodeConsistent = EncodeConsistent && other.EncodeConsistent;
+        DecodeConsistent = DecodeConsistent && other.DecodeConsistent;
+    }
+};
+
+template <typename Coder>
+VerifyResult VerifyValues(Coder coder, uint32_t quantization, uint32_t first, uint32_t last)
+{
+    VerifyResult ret;
+    uint32_t count = last - first;
+    vector<uint16_t> values(count);
+    vector<uint8_t> colors(count * 3);
+    vector<uint16_t> decoded(count);
+    vector<uint32_t> rgbx(count);
+    vector<uint16_t> decodedRgbx(count);
+
+    for (uint32_t i=0; i<count; i++)
+        values[i] = first + i;
+
+    coder.Encode(values.data(), colors.data(), count);
+    coder.Decode(colors.data(), decoded.data(), count);
+    coder.EncodeRgbx(values.data(), rgbx.data(), count);
+    coder.DecodeRgbx(rgbx.data(), decodedRgbx.data(), count);
+
+    for (uint32_t i=0; i<count; i++)
+    {
+        uint16_t expected = (values[i] >> (16 - quantization)) << (16 - quantization);
+        Color c = coder.ValueToColor(values[i]);
+        uint16_t d = coder.ColorToValue(c);
+        uint32_t err = std::abs((int)d - (int)expected);
+
+        if (c.x != colors[i*3] || c.y != colors[i*3+1] || c.z != colors[i*3+2] || rgbx[i] != PackRgbx(c))
+            ret.EncodeConsistent = false;
+        if (d != decoded[i] || d != decodedRgbx[i])
+            ret.DecodeConsistent = false;
+
+        if (err)
+            ret.Mismatches++;
+        ret.SumErr += err;
+        if (err > ret.MaxErr)
+        {
+            ret.MaxErr = err;
+            ret.MaxErrValue = values[i];
+        }
+    }
+
+    return ret;
+}
+
+// Decodes the 256x256 colours of one red slice of the RGB cube
+template <typename Coder>
+VerifyResult VerifyColors(Coder coder, uint8_t red)
+{
+    VerifyResult ret;
+    vector<uint8_t> colors(256 * 256 * 3);
+    vector<uint16_t> decoded(256 * 256);
+
+    for (uint32_t g=0; g<256; g++)
+    {
+        for (uint32_t b=0; b<256; b++)
+        {
+            uint32_t i = g * 256 + b;
+            colors[i*3] = red; colors[i*3+1] = g; colors[i*3+2] = b;
+        }
+    }
+    coder.Decode(colors.data(), decoded.data(), 256 * 256);
+
+    for (uint32_t i=0; i<256 * 256; i++)
+    {
+        Color c = {colors[i*3], colors[i*3+1], colors[i*3+2]};
+        uint16_t d = coder.ColorToValue(c);
+        Color reencoded = coder.ValueToColor(d);
+
+        if (d != decoded[i])
+            ret.DecodeConsistent = false;
+
+        uint32_t dist = 0;
+        for (uint32_t k=0; k<3; k++)
+            dist = std::max<uint32_t>(dist, std::abs((int)c[k] - (int)reencoded[k]));
+        ret.MaxColorDistance = std::max(ret.MaxColorDistance, dist);
+    }
+
+    return ret;
+}
+
+struct Case
+{
+    string Name;
+    bool Lossless;
+    VerifyResult Result;
+};
+
+template <typename Coder>
+void AddCase(vector<Case>& cases, ThreadPool& pool, const string& name, const Coder& coder, uint32_t quantization, bool lossless)
+{
+    const uint32_t valueChunk = 4096;
+    cases.push_back({name, lossless, VerifyResult()});
+
+    // Per-task partial results, merged once the pool is done
+    auto partials = make_shared<vector<VerifyResult>>(65536 / valueChunk + 256);
+    size_t idx = cases.size() - 1;
+
+    for (uint32_t first=0; first<65536; first+=valueChunk)
+        pool.Submit([partials, coder, quantization, first, valueChunk]() {
+            (*partials)[first / valueChunk] = VerifyValues(coder, quantization, first, first + valueChunk);
+        });
+    for (uint32_t red=0; red<256; red++)
+        pool.Submit([partials, coder, red]() {
+            (*partials)[65536 / valueChunk + red] = VerifyColors(coder, red);
+        });
+
+    pool.Wait();
+    for (auto& partial : *partials)
+        cases[idx].Result.Merge(partial);
+}
+
+// Hilbert transpose must be a bijection on the curve cube
+bool VerifyHilbertTranspose(uint32_t q, uint32_t curveBits)
+{
+    HilbertCoder hc(q, curveBits);
+    uint32_t side = 1 << curveBits;
+
+    for (uint32_t i=0; i<side; i++)
+        for (uint32_t j=0; j<side; j++)
+            for (uint32_t k=0; k<side; k++)
+            {
+                Color col = {(uint8_t)i, (uint8_t)j, (uint8_t)k};
+                Color col2 = col;
+                hc.TransposeToHilbertCoords(col2);
+                hc.TransposeFromHilbertCoords(col2);
+                if (col != col2)
+                    return false;
+            }
+    return true;
+}
+
+// MedianFilter against the textbook definition on a noisy image with spikes: the median of the clamped window from
+// nth_element, replacing the pixel only when it is further than threshold from it
+bool VerifyMedianFilter(uint32_t width, uint32_t height, uint32_t window, uint32_t threshold, uint32_t nThreads)
+{
+    mt19937 rng(width * 31 + height);
+    vector<uint16_t> data(width * height);
+    for (uint32_t i=0; i<data.size(); i++)
+        data[i] = rng() % 64 == 0 ? rng() % 65536 : 30000 + i % width * 7 + rng() % 200;
+
+    vector<uint16_t> expected(data.size());
+    int32_t radius = window / 2;
+    vector<uint16_t> neighbours;
+    for (int32_t y=0; y<(int32_t)height; y++)
+    {
+        for (int32_t x=0; x<(int32_t)width; x++)
+        {
+            neighbours.clear();
+            for (int32_t dy=-radius; dy<=radius; dy++)
+                for (int32_t dx=-radius; dx<=radius; dx++)
+                {
+                    int32_t sx = std::min(std::max(x + dx, 0), (int32_t)width - 1);
+                    int32_t sy = std::min(std::max(y + dy, 0), (int32_t)height - 1);
+                    neighbours.push_back(data[sx + sy * width]);
+                }
+            nth_element(neighbours.begin(), neighbours.begin() + neighbours.size() / 2, neighbours.end());
+
+            uint16_t median = neighbours[neighbours.size() / 2], current = data[x + y * width];
+            expected[x + y * width] = (uint32_t)std::abs((int32_t)current - (int32_t)median) > threshold ? median : current;
+        }
+    }
+
+    MedianFilter(data.data(), width, height, window, threshold, nThreads);
+    return data == expected;
+}
+
+int main(int argc, char *argv[])
+{
+    ThreadPool pool(argc > 1 ? atoi(argv[1]) : 0);
+    vector<Case> cases;
+    bool failed = false;
+
+    AddCase(cases, pool, "PACKED", PackedCoder(16), 16, true);
+    AddCase(cases, pool, "TRIANGLE", TriangleCoder(16), 16, false);
+    AddCase(cases, pool, "PHASE", PhaseCoder(16), 16, false);
+    AddCase(cases, pool, "SPLIT", SplitCoder(16), 16, false);
+    for (uint32_t q=8; q<=16; q++)
+    {
+        for (uint32_t bits=1; bits<=6; bits++)
+        {
+            if (!IsValidCoder("MORTON", q, bits))
+                continue;
+
+            stringstream ss;
+            ss << "MORTON(" << q << "," << bits << ")";
+            AddCase(cases, pool, ss.str(), MortonCoder(q, bits), q, true);
+        }
+    }
+    for (uint32_t q=8; q<=16; q++)
+    {
+        for (uint32_t bits=1; bits<=5; bits++)
+        {
+            if (!IsValidCoder("HILBERT", q, bits))
+                continue;
+
+            stringstream ss;
+            ss << "HILBERT(" << q << "," << bits << ")";
+            AddCase(cases, pool, ss.str(), HilbertCoder(q, bits), q, true);
+
+            if (!VerifyHilbertTranspose(q, bits))
+            {
+                cout << ss.str() << ": Hilbert transpose is not invertible" << endl;
+                failed = true;
+            }
+        }
+    }
+
+    // Widths around the 32 pixel lanes, heights from a single row to several bands
+    const uint32_t sizes[][2] = {{1, 1}, {7, 3}, {32, 32}, {33, 70}, {100, 257}};
+    for (auto& size : sizes)
+        for (uint32_t window : {3u, 5u})
+            for (uint32_t threshold : {0u, 500u})
+                for (uint32_t nThreads : {1u, 4u})
+                    if (!VerifyMedianFilter(size[0], size[1], window, threshold, nThreads))
+                    {
+                        cout << "MedianFilter " << size[0] << "x" << size[1] << " window " << window << " threshold "
+                             << threshold << " threads " << nThreads << ": differs from the reference" << endl;
+                        failed = true;
+                    }
+
+    cout << "Coder\tMaxErr\tAt\tAvgErr\tMismatches\tMaxColorDist\tEncode\tDecode" << endl;
+    for (auto& c : cases)
+    {
+        const VerifyResult& r = c.Result;
+        bool ok = r.EncodeConsistent && r.DecodeConsistent && (!c.Lossless || r.MaxErr == 0);
+        failed = failed || !ok;
+
+        cout << c.Name << "\t" << r.MaxErr << "\t" << r.MaxErrValue << "\t" << r.SumErr / 65536.0 << "\t" << r.Mismatches << "\t"
+             << r.MaxColorDistance << "\t" << (r.EncodeConsistent ? "ok" : "MISMATCH") << "\t"
+             << (r.DecodeConsistent ? "ok" : "MISMATCH") << (ok ? "" : "\tFAILED") << endl;
+    }
+
+    return failed ? 1 : 0;
+}
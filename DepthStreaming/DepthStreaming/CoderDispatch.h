@@ -0,0 +1,80 @@
+#ifndef CODERDISPATCH_H
+#define CODERDISPATCH_H
+
+#include <HilbertCoder.h>
+#include <MortonCoder.h>
+#include <SplitCoder.h>
+#include <PhaseCoder.h>
+#include <TriangleCoder.h>
+#include <PackedCoder.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace DStream
+{
+    // Coder configurations that round trip exactly before JPEG. Hilbert needs at least one segment bit and the curve
+    // plus segment bits of a channel in 8 bits (5 curve bits are spread over the channel), Morton interleaves 3 bits
+    // per curve bit and must cover the whole quantization.
+    inline bool IsValidCoder(const std::string& algo, uint32_t quantization, uint32_t curveBits)
+    {
+        if (!algo.compare("HILBERT"))
+            return curveBits > 0 && curveBits * 3 < quantization && quantization - 2 * curveBits <= 8;
+        if (!algo.compare("MORTON"))
+            return curveBits > 0 && curveBits <= 6 && curveBits * 3 >= quantization && quantization <= 16;
+        return quantization > 0 && quantization <= 16;
+    }
+
+    // JPEG component scales measured on DEMs at about the same max error: the low byte of PACKED and SPLIT and the
+    // phase of PHASE take coarser steps, the empty blue channel the coarsest. The curve coders and TRIANGLE are limited
+    // by decoding spikes rather than by the quantization of a single channel, they keep the plain tables.
+    inline std::vector<float> ComponentScalePreset(const std::string& algo)
+    {
+        if (!algo.compare("PACKED"))
+            return {0.5f, 16.0f, 16.0f};
+        if (!algo.compare("SPLIT"))
+            return {0.5f, 8.0f, 16.0f};
+        if (!algo.compare("PHASE"))
+            return {2.0f, 1.0f, 16.0f};
+        return {};
+    }
+
+    // Calls f with the coder named algo, for the kernels templated on the coder. Unknown names don't call f.
+    template <typename F>
+    void WithCoder(const std::string& algo, uint32_t quantization, uint32_t curveBits, F f)
+    {
+        if (!algo.compare("MORTON"))
+        {
+            MortonCoder c(quantization, curveBits);
+            f(c);
+        }
+        else if (!algo.compare("HILBERT"))
+        {
+            HilbertCoder c(quantization, curveBits);
+            f(c);
+        }
+        else if (!algo.compare("PACKED"))
+        {
+            PackedCoder c(quantization);
+            f(c);
+        }
+        else if (!algo.compare("SPLIT"))
+        {
+            SplitCoder c(quantization);
+            f(c);
+        }
+        else if (!algo.compare("PHASE"))
+        {
+            PhaseCoder c(quantization);
+            f(c);
+        }
+        else if (!algo.compare("TRIANGLE"))
+        {
+            TriangleCoder c(quantization);
+            f(c);
+        }
+    }
+}
+
+#endif // CODERDISPATCH_H
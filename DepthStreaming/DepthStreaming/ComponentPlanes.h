@@ -0,0 +1,123 @@
+#ifndef COMPONENTPLANES_H
+#define COMPONENTPLANES_H
+
+#include <Vec3.h>
+
+#include <cstdint>
+#include <algorithm>
+
+namespace DStream
+{
+    // Colour basis of the planes a coder emits: its own channels stored as JPEG RGB components, or converted to YCbCr
+    // by the coder instead of by libjpeg
+    enum PlaneBasis { RGB_PLANES = 0, YCBCR_PLANES };
+
+    // Fixed point RGB -> YCbCr with the same coefficients and rounding as libjpeg's jccolor.c
+    inline void RgbToYCbCr(int r, int g, int b, uint8_t& y, uint8_t& cb, uint8_t& cr)
+    {
+        const int32_t half = 1 << 15, offset = 128 << 16;
+        y = (19595 * r + 38470 * g + 7471 * b + half) >> 16;
+        cb = (-11059 * r - 21709 * g + 32768 * b + offset + half - 1) >> 16;
+        cr = (32768 * r - 27439 * g - 5329 * b + offset + half - 1) >> 16;
+    }
+
+    // Fixed point YCbCr -> RGB tables with the same coefficients and rounding as libjpeg's jdcolor.c
+    struct YCbCrTables
+    {
+        int CrR[256], CbB[256];
+        int32_t CrG[256], CbG[256];
+    };
+
+    inline const YCbCrTables& GetYCbCrTables()
+    {
+        static const YCbCrTables tables = []() {
+            YCbCrTables t;
+            const int32_t half = 1 << 15;
+            for (int i=0; i<256; i++)
+            {
+                int x = i - 128;
+                t.CrR[i] = (91881 * x + half) >> 16;
+                t.CbB[i] = (116130 * x + half) >> 16;
+                t.CrG[i] = -46802 * x;
+                t.CbG[i] = -22554 * x + half;
+            }
+            return t;
+        }();
+        return tables;
+    }
+
+    // Coder output written straight into one plane per component (rows of stride bytes) instead of an interleaved
+    // buffer, ready for raw data JPEG compression. Only the width x height area is written, the padding is left to
+    // the encoder.
+    template <typename Coder>
+    void EncodePlanes(Coder& coder, const uint16_t* values, uint8_t* const* planes, uint32_t width, uint32_t height,
+                      uint32_t stride, PlaneBasis basis)
+    {
+        for (uint32_t y=0; y<height; y++)
+        {
+            const uint16_t* src = values + y * width;
+            uint8_t* p0 = planes[0] + y * stride;
+            uint8_t* p1 = planes[1] + y * stride;
+            uint8_t* p2 = planes[2] + y * stride;
+
+            if (basis == YCBCR_PLANES)
+            {
+                for (uint32_t x=0; x<width; x++)
+                {
+                    Color c = coder.ValueToColor(src[x]);
+                    RgbToYCbCr(c.x, c.y, c.z, p0[x], p1[x], p2[x]);
+                }
+            }
+            else
+            {
+                for (uint32_t x=0; x<width; x++)
+                {
+                    Color c = coder.ValueToColor(src[x]);
+                    p0[x] = c.x;
+                    p1[x] = c.y;
+                    p2[x] = c.z;
+                }
+            }
+        }
+    }
+
+    // Inverse of EncodePlanes on the raw component planes of a decoded JPEG: the colour conversion libjpeg would do is
+    // fused with the coder's ColorToValue, so the decoded image is only read once
+    template <typename Coder>
+    void DecodePlanes(Coder& coder, const uint8_t* const* planes, uint16_t* dest, uint32_t width, uint32_t height,
+                      uint32_t stride, PlaneBasis basis)
+    {
+        const YCbCrTables& t = GetYCbCrTables();
+
+        for (uint32_t y=0; y<height; y++)
+        {
+            const uint8_t* p0 = planes[0] + y * stride;
+            const uint8_t* p1 = planes[1] + y * stride;
+            const uint8_t* p2 = planes[2] + y * stride;
+            uint16_t* row = dest + y * width;
+
+            if (basis == YCBCR_PLANES)
+            {
+                for (uint32_t x=0; x<width; x++)
+                {
+                    int luma = p0[x], cb = p1[x], cr = p2[x];
+                    Color c;
+                    c.x = std::clamp(luma + t.CrR[cr], 0, 255);
+                    c.y = std::clamp(luma + ((t.CbG[cb] + t.CrG[cr]) >> 16), 0, 255);
+                    c.z = std::clamp(luma + t.CbB[cb], 0, 255);
+                    row[x] = coder.ColorToValue(c);
+                }
+            }
+            else
+            {
+                for (uint32_t x=0; x<width; x++)
+                {
+                    Color c = {p0[x], p1[x], p2[x]};
+                    row[x] = coder.ColorToValue(c);
+                }
+            }
+        }
+    }
+}
+
+#endif // COMPONENTPLANES_H
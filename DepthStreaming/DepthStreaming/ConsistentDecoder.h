@@ -0,0 +1,87 @@
+#ifndef CONSISTENTDECODER_H
+#define CONSISTENTDECODER_H
+
+#include <Vec3.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+namespace DStream
+{
+    // Raster decode for the curve coders (Hilbert, Morton), where a colour pushed across a cell boundary by JPEG
+    // noise decodes to a value far from the truth. Each pixel is first decoded as usual and compared with a prediction
+    // from its already decoded left, top and top-left neighbours (the LOCO-I median predictor). If it is further than
+    // threshold, the colours at -spacing, 0, +spacing on every channel are decoded as candidates and the one closest to
+    // the prediction wins. Only the previous decoded row is read back, so the pass streams through memory.
+    // values holds pixelSize bytes per pixel, RGB (3) or RGBX (4).
+    template <typename Coder>
+    void DecodeConsistent(Coder& coder, const uint8_t* values, uint16_t* dest, uint32_t width, uint32_t height,
+                          uint32_t spacing, uint32_t threshold, uint32_t pixelSize = 3)
+    {
+        for (uint32_t y=0; y<height; y++)
+        {
+            const uint8_t* src = values + y * width * pixelSize;
+            uint16_t* row = dest + y * width;
+            const uint16_t* above = row - width;
+
+            for (uint32_t x=0; x<width; x++)
+            {
+                const uint8_t* pixel = src + x * pixelSize;
+                Color color = {pixel[0], pixel[1], pixel[2]};
+                uint16_t decoded = coder.ColorToValue(color);
+
+                int prediction;
+                if (x == 0 && y == 0)
+                {
+                    row[x] = decoded;
+                    continue;
+                }
+                else if (y == 0)
+                    prediction = row[x-1];
+                else if (x == 0)
+                    prediction = above[x];
+                else
+                {
+                    int a = row[x-1], b = above[x], c = above[x-1];
+                    if (c >= std::max(a, b))
+                        prediction = std::min(a, b);
+                    else if (c <= std::min(a, b))
+                        prediction = std::max(a, b);
+                    else
+                        prediction = a + b - c;
+                }
+
+                uint32_t best = std::abs((int)decoded - prediction);
+                if (best > threshold)
+                {
+                    for (int dx=-1; dx<=1; dx++)
+                    {
+                        for (int dy=-1; dy<=1; dy++)
+                        {
+                            for (int dz=-1; dz<=1; dz++)
+                            {
+                                int r = color.x + dx * (int)spacing, g = color.y + dy * (int)spacing, b = color.z + dz * (int)spacing;
+                                if (r < 0 || g < 0 || b < 0 || r > 255 || g > 255 || b > 255)
+                                    continue;
+
+                                Color candidate = {(uint8_t)r, (uint8_t)g, (uint8_t)b};
+                                uint16_t value = coder.ColorToValue(candidate);
+                                uint32_t distance = std::abs((int)value - prediction);
+                                if (distance < best)
+                                {
+                                    best = distance;
+                                    decoded = value;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                row[x] = decoded;
+            }
+        }
+    }
+}
+
+#endif // CONSISTENTDECODER_H
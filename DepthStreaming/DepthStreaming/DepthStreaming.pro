@@ -6,17 +6,35 @@ CONFIG -= app_bundle
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 win32:LIBS += \
-    $$PWD/../Deps/libjpeg-turbo-2.0.6/bin/jpeg62.dll
+    $$PWD/../Deps/libjpeg-turbo-2.0.6/bin/jpeg62.dll \
+    -lpsapi
+# zlib for the PNG encoder
+unix:LIBS += -lz
+
 win32:INCLUDEPATH += \
     $$PWD/../Deps/libjpeg-turbo-2.0.6/include
 
+# 12 bit greyscale JPEG coder (JPEG12), needs ../Jpeg12/Jpeg12.pro built first: qmake CONFIG+=jpeg12
+jpeg12 {
+    DEFINES += DSTREAM_JPEG12
+    INCLUDEPATH += $$PWD/../Jpeg12
+    LIBS += -L$$OUT_PWD/../Jpeg12 -ljpeg12
+}
+
 SOURCES += \
+        ErrorAnalysis.cpp \
         HilbertCoder.cpp \
+        MedianFilter.cpp \
         MortonCoder.cpp \
         PackedCoder.cpp \
         Parser.cpp \
         PhaseCoder.cpp \
+        PngEncoder.cpp \
+        Profiler.cpp \
+        RateDistortion.cpp \
+        SplitChannels.cpp \
         SplitCoder.cpp \
+        ThreadPool.cpp \
         TriangleCoder.cpp \
         Writer.cpp \
         jpeg_decoder.cpp \
@@ -30,15 +48,28 @@ else: unix:!android: target.path = /opt/$${TARGET}/bin
 
 HEADERS += \
     Algorithm.h \
+    CoderDispatch.h \
+    ComponentPlanes.h \
+    ConsistentDecoder.h \
+    ErrorAnalysis.h \
+    GetOpt.h \
     HilbertCoder.h \
+    MedianFilter.h \
     MortonCoder.h \
     PackedCoder.h \
     Parser.h \
     PhaseCoder.h \
+    PngEncoder.h \
+    Profiler.h \
+    RateDistortion.h \
+    RgbxLayout.h \
+    SplitChannels.h \
     SplitCoder.h \
+    ThreadPool.h \
     TriangleCoder.h \
     Vec3.h \
     Writer.h \
     jpeg_decoder.h \
-    jpeg_encoder.h
+    jpeg_encoder.h \
+    jpeg_profile.h
 
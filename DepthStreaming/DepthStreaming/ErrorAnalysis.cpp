@@ -0,0 +1,153 @@
+#include <ErrorAnalysis.h>
+#include <ThreadPool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <fstream>
+
+namespace DStream
+{
+    // Below this many pixels the threads cost more than they save
+    static const size_t s_MinParallelCount = 1 << 18;
+    static const uint32_t s_BlockSize = 256;
+
+    struct PartialError
+    {
+        uint32_t Max = 0;
+        uint64_t Sum = 0;
+        uint64_t SumSquared = 0;
+        std::vector<uint32_t> Histogram;
+    };
+
+    static void AnalyzeRange(const uint16_t* original, const uint16_t* decoded, size_t count, PartialError& ret)
+    {
+        uint32_t errors[s_BlockSize];
+        ret.Histogram.assign(65536, 0);
+
+        for (size_t start=0; start<count; start+=s_BlockSize)
+        {
+            uint32_t n = std::min<size_t>(s_BlockSize, count - start);
+            uint32_t blockMax = 0;
+            uint64_t blockSum = 0, blockSumSquared = 0;
+
+            // Branch-free loops over a fixed block, these get vectorized by the compiler
+            for (uint32_t i=0; i<n; i++)
+                errors[i] = std::abs((int32_t)original[start + i] - (int32_t)decoded[start + i]);
+            for (uint32_t i=0; i<n; i++)
+            {
+                blockMax = std::max(blockMax, errors[i]);
+                blockSum += errors[i];
+                blockSumSquared += (uint64_t)errors[i] * errors[i];
+            }
+            for (uint32_t i=0; i<n; i++)
+                ret.Histogram[errors[i]]++;
+
+            ret.Max = std::max(ret.Max, blockMax);
+            ret.Sum += blockSum;
+            ret.SumSquared += blockSumSquared;
+        }
+    }
+
+    static uint16_t Percentile(const std::vector<uint32_t>& histogram, size_t count, double p)
+    {
+        size_t target = std::max<size_t>(1, (size_t)std::ceil(p * count));
+        size_t accumulated = 0;
+
+        for (uint32_t e=0; e<histogram.size(); e++)
+        {
+            accumulated += histogram[e];
+            if (accumulated >= target)
+                return e;
+        }
+        return 65535;
+    }
+
+    // Merges the per-thread results into the metrics
+    static ErrorStats MergeErrors(std::vector<PartialError>& partials, size_t count, std::vector<uint32_t>* histogram)
+    {
+        ErrorStats ret;
+        PartialError& total = partials[0];
+        for (size_t i=1; i<partials.size(); i++)
+        {
+            total.Max = std::max(total.Max, partials[i].Max);
+            total.Sum += partials[i].Sum;
+            total.SumSquared += partials[i].SumSquared;
+            for (uint32_t e=0; e<65536; e++)
+                total.Histogram[e] += partials[i].Histogram[e];
+        }
+
+        ret.Count = count;
+        if (count)
+        {
+            ret.Max = total.Max;
+            ret.Mean = (double)total.Sum / count;
+            ret.Rmse = std::sqrt((double)total.SumSquared / count);
+            ret.Psnr = ret.Rmse > 0.0 ? 20.0 * std::log10(65535.0 / ret.Rmse) : std::numeric_limits<double>::infinity();
+            ret.P50 = Percentile(total.Histogram, count, 0.5);
+            ret.P99 = Percentile(total.Histogram, count, 0.99);
+            ret.P999 = Percentile(total.Histogram, count, 0.999);
+        }
+
+        if (histogram)
+            histogram->swap(total.Histogram);
+        return ret;
+    }
+
+    ErrorStats AnalyzeError(const uint16_t* original, const uint16_t* decoded, size_t count, uint32_t nThreads,
+                            std::vector<uint32_t>* histogram)
+    {
+        if (nThreads == 1 || count < s_MinParallelCount)
+        {
+            std::vector<PartialError> partials(1);
+            AnalyzeRange(original, decoded, count, partials[0]);
+            return MergeErrors(partials, count, histogram);
+        }
+
+        ThreadPool pool(nThreads);
+        return AnalyzeError(original, decoded, count, pool, histogram);
+    }
+
+    ErrorStats AnalyzeError(const uint16_t* original, const uint16_t* decoded, size_t count, ThreadPool& pool,
+                            std::vector<uint32_t>* histogram)
+    {
+        std::vector<PartialError> partials;
+
+        if (pool.GetThreadCount() == 1 || count < s_MinParallelCount)
+        {
+            partials.resize(1);
+            AnalyzeRange(original, decoded, count, partials[0]);
+        }
+        else
+        {
+            size_t chunk = (count + pool.GetThreadCount() - 1) / pool.GetThreadCount();
+
+            partials.resize(pool.GetThreadCount());
+            for (size_t i=0; i<partials.size(); i++)
+            {
+                size_t start = std::min(count, i * chunk);
+                size_t n = std::min(count, start + chunk) - start;
+                PartialError& partial = partials[i];
+                pool.Submit([original, decoded, start, n, &partial]() {
+                    AnalyzeRange(original + start, decoded + start, n, partial);
+                });
+            }
+            pool.Wait();
+        }
+
+        return MergeErrors(partials, count, histogram);
+    }
+
+    bool WriteErrorHistogram(const std::string& path, const std::vector<uint32_t>& histogram)
+    {
+        std::ofstream out(path, std::ios::out);
+        if (!out.is_open())
+            return false;
+
+        out << "Error,Frequency" << std::endl;
+        for (uint32_t e=0; e<histogram.size(); e++)
+            if (histogram[e] != 0)
+                out << e << "," << histogram[e] << "\n";
+        return out.good();
+    }
+}
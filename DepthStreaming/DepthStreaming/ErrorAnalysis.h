@@ -0,0 +1,41 @@
+#ifndef ERRORANALYSIS_H
+#define ERRORANALYSIS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+
+namespace DStream
+{
+    class ThreadPool;
+
+    struct ErrorStats
+    {
+        size_t Count = 0;
+        uint32_t Max = 0;
+        double Mean = 0.0;
+        double Rmse = 0.0;
+        // Peak signal is the full 16 bit range, infinite for a lossless decode
+        double Psnr = 0.0;
+
+        uint16_t P50 = 0;
+        uint16_t P99 = 0;
+        uint16_t P999 = 0;
+    };
+
+    // Computes every error metric in a single pass over the two buffers, split over nThreads workers (0 uses every
+    // core, 1 runs on the calling thread). The dense 65536-bin histogram of absolute errors is always built to
+    // get the percentiles, and is returned if a destination is given.
+    ErrorStats AnalyzeError(const uint16_t* original, const uint16_t* decoded, size_t count, uint32_t nThreads = 0,
+                            std::vector<uint32_t>* histogram = nullptr);
+    // Same on the workers of a caller-owned pool, for callers analyzing many images in a row. The pool must be idle:
+    // it is waited on.
+    ErrorStats AnalyzeError(const uint16_t* original, const uint16_t* decoded, size_t count, ThreadPool& pool,
+                            std::vector<uint32_t>* histogram = nullptr);
+
+    // Writes the non-empty bins as "Error,Frequency" rows
+    bool WriteErrorHistogram(const std::string& path, const std::vector<uint32_t>& histogram);
+}
+
+#endif // ERRORANALYSIS_H
@@ -0,0 +1,93 @@
+#ifndef GETOPT_H
+#define GETOPT_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Command line parsing shared by the benchmark and the tools: POSIX getopt, with a copy for MSVC
+
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+
+inline int opterr = 1, optind = 1, optopt, optreset;
+inline const char* optarg;
+
+inline int getopt(int nargc, char* const nargv[], const char* ostr) {
+    static const char* place = "";        // option letter processing
+    const char* oli;                      // option letter list index
+
+    if (optreset || !*place) {             // update scanning pointer
+        optreset = 0;
+        if (optind >= nargc || *(place = nargv[optind]) != '-') {
+            place = "";
+            return -1;
+        }
+
+        if (place[1] && *++place == '-') { // found "--"
+            ++optind;
+            place = "";
+            return -1;
+        }
+    }                                       // option letter okay?
+
+    if ((optopt = (int)*place++) == (int)':' || !(oli = strchr(ostr, optopt))) {
+        // if the user didn't specify '-' as an option,  assume it means -1.
+        if (optopt == (int)'-')
+            return (-1);
+        if (!*place)
+            ++optind;
+        if (opterr && *ostr != ':')
+            std::cout << "illegal option -- " << optopt << "\n";
+        return ('?');
+    }
+
+    if (*++oli != ':') {                    // don't need argument
+        optarg = NULL;
+        if (!*place)
+            ++optind;
+
+    }
+    else {                                // need an argument
+        if (*place)                         // no white space
+            optarg = place;
+        else if (nargc <= ++optind) {       // no arg
+            place = "";
+            if (*ostr == ':')
+                return (':');
+            if (opterr)
+                std::cout << "option requires an argument -- " << optopt << "\n";
+            return (':');
+        }
+        else                              // white space
+            optarg = nargv[optind];
+        place = "";
+        ++optind;
+    }
+    return optopt;                          // dump back option letter
+}
+
+#endif
+
+namespace DStream
+{
+    // Comma separated list of unsigned integers
+    inline std::vector<uint32_t> ParseList(const std::string& list)
+    {
+        std::vector<uint32_t> ret;
+        std::stringstream ss(list);
+        std::string item;
+
+        while (getline(ss, item, ','))
+            ret.push_back(atoi(item.c_str()));
+        return ret;
+    }
+}
+
+#endif // GETOPT_H
@@ -1,5 +1,7 @@
 #include <HilbertCoder.h>
+#include <RgbxLayout.h>
 #include <MortonCoder.h>
+#include <ConsistentDecoder.h>
 
 #include <vector>
 #include <assert.h>
@@ -16,6 +18,12 @@ namespace DStream
 
         assert(m_CurveBits + m_SegmentBits <= 8);
         m_OptimizeSpacing = optimizeSpacing;
+
+        uint32_t last = (1 << (3 * m_CurveBits)) - 1;
+        Color end = CurvePoint(last), previous = CurvePoint(last - 1);
+        for (m_LastAxis = 0; m_LastAxis < 2; m_LastAxis++)
+            if (previous[m_LastAxis] != end[m_LastAxis] + 1)
+                break;
     }
 
     void HilbertCoder::Encode(uint16_t* values, uint8_t* dest, uint32_t count)
@@ -38,6 +46,24 @@ namespace DStream
         }
     }
 
+    void HilbertCoder::EncodeRgbx(uint16_t* values, uint32_t* dest, uint32_t count)
+    {
+        DStream::EncodeRgbx(*this, values, dest, count);
+    }
+
+    void HilbertCoder::DecodeRgbx(uint32_t* values, uint16_t* dest, uint32_t count)
+    {
+        DStream::DecodeRgbx(*this, values, dest, count);
+    }
+
+    void HilbertCoder::DecodeConsistent(uint8_t* values, uint16_t* dest, uint32_t width, uint32_t height, uint32_t threshold,
+                                        uint32_t pixelSize)
+    {
+        // Candidates half a curve cell away reach the neighbouring cells without skipping over them
+        uint32_t spacing = m_SegmentBits ? 1 << (m_SegmentBits - 1) : 1;
+        DStream::DecodeConsistent(*this, values, dest, width, height, spacing, threshold, pixelSize);
+    }
+
     void HilbertCoder::TransposeFromHilbertCoords(Color& col)
     {
         int X[3] = {col.x, col.y, col.z};
@@ -97,9 +123,10 @@ namespace DStream
     Color HilbertCoder::Enlarge(Color col)
     {
         Color ret = col;
-        static std::vector<uint8_t> occupancy;
-        static std::vector<uint8_t> remap;
-        if(occupancy.size() == 0) {
+        // Built once in a thread-safe static initializer, coders can be used concurrently
+        static const std::vector<uint8_t> remap = []() {
+            std::vector<uint8_t> occupancy;
+            std::vector<uint8_t> remap;
             occupancy.push_back(1);
             int gap = 1;
             while(gap < 64) {
@@ -115,7 +142,9 @@ namespace DStream
                 if(occupancy[i])
                     remap.push_back(i);
             }
-        }
+            return remap;
+        }();
+
         for(int k = 0; k < 3; k++)
             ret[k] = remap[ret[k]];
         return ret;
@@ -123,11 +152,8 @@ namespace DStream
 
     Color HilbertCoder::Shrink(Color col)
     {
-        static std::vector<uint8_t> occupancy;
-        static std::vector<uint8_t> remap;
-        Color ret = col;
-
-        if(occupancy.size() == 0) {
+        static const std::vector<uint8_t> occupancy = []() {
+            std::vector<uint8_t> occupancy;
             occupancy.push_back(0);
             int gap = 1;
             while(gap < 64) {
@@ -143,28 +169,47 @@ namespace DStream
                     occupancy.push_back(occupancy[i] + last+1);
                 gap *= 2;
             }
-        }
+            return occupancy;
+        }();
+        Color ret = col;
+
         for(int k = 0; k < 3; k++)
             ret[k] = occupancy[ret[k]];
 
         return ret;
     }
 
+    Color HilbertCoder::CurvePoint(uint32_t index)
+    {
+        // Only interleaves the curve index, the depth is already quantized
+        MortonCoder m(16, m_CurveBits);
+        Color ret = m.ValueToColor(index);
+        std::swap(ret[0], ret[2]);
+        TransposeFromHilbertCoords(ret);
+        return ret;
+    }
+
+    uint32_t HilbertCoder::CurveIndex(Color point)
+    {
+        MortonCoder m(16, m_CurveBits);
+        TransposeToHilbertCoords(point);
+        std::swap(point[0], point[2]);
+        return m.ColorToValue(point);
+    }
+
     Color HilbertCoder::ValueToColor(uint16_t val)
     {
         val >>= 16 - m_Quantization;
         int frac = val & ((1 << m_SegmentBits) - 1);
         val >>= m_SegmentBits;
 
-        MortonCoder m(m_Quantization, m_CurveBits);
-        Color v = m.ValueToColor(val);
-        Color v2 = m.ValueToColor(val + 1);
-
-        std::swap(v[0], v[2]);
-        std::swap(v2[0], v2[2]);
-
-        TransposeFromHilbertCoords(v);
-        TransposeFromHilbertCoords(v2);
+        // Moving up along an axis stays in the cell, so the last segment can go past the end of the curve
+        Color v = CurvePoint(val);
+        Color v2 = v;
+        if (val + 1u < (1u << (3 * m_CurveBits)))
+            v2 = CurvePoint(val + 1);
+        else
+            v2[m_LastAxis]++;
 
         // Divide in segments
         for (uint32_t i=0; i<3; i++)
@@ -179,10 +224,52 @@ namespace DStream
 
     uint16_t HilbertCoder::ColorToValue(const Color& col)
     {
-        MortonCoder m(m_Quantization, m_CurveBits);
-        Color col1 = col;//m_CurveBits == 5 ? Shrink(col) : col;
+        MortonCoder m(16, m_CurveBits);
+        // 5 curve bits are spread over the whole channel by Enlarge
+        Color col1 = m_CurveBits == 5 ? Shrink(col) : col;
         Color col2 = col1;
 
+        // Exact inverse for colours on the curve: at most one channel between two cells. Its cell is the start of the
+        // segment if the next curve point is the neighbour up that axis, the end if the previous one is.
+        uint32_t segment = 1 << m_SegmentBits;
+        int axis = -1;
+        bool onCurve = true;
+        Color cell;
+        for (uint32_t i=0; i<3; i++)
+        {
+            cell[i] = col1[i] >> m_SegmentBits;
+            if (col1[i] & (segment - 1))
+            {
+                onCurve = axis < 0;
+                axis = i;
+            }
+        }
+        if (onCurve)
+        {
+            uint32_t index = CurveIndex(cell);
+            uint32_t value = 0;
+            bool found = true;
+            if (axis < 0)
+                value = index << m_SegmentBits;
+            else
+            {
+                uint32_t frac = col1[axis] & (segment - 1);
+                Color up = cell;
+                up[axis]++;
+                bool last = index + 1 == (1u << (3 * m_CurveBits));
+                if (last ? (uint32_t)axis == m_LastAxis : CurvePoint(index + 1) == up)
+                    value = (index << m_SegmentBits) + frac;
+                else if (index > 0 && CurvePoint(index - 1) == up)
+                    value = ((index - 1) << m_SegmentBits) + segment - frac;
+                else
+                    found = false;
+            }
+            if (found)
+                return value << (16 - m_Quantization);
+        }
+
+        // Closest guess for the others, e.g. JPEG noise
+
         Color currColor;
 
         uint8_t fract = 0;
@@ -14,6 +14,12 @@ namespace DStream
         HilbertCoder(uint32_t q, uint32_t curveBits, bool optimizeSpacing = false);
         void Encode(uint16_t* values, uint8_t* dest, uint32_t count);
         void Decode(uint8_t* values, uint16_t* dest, uint32_t count);
+        // 4 byte RGBX pixels, see RgbxLayout.h
+        void EncodeRgbx(uint16_t* values, uint32_t* dest, uint32_t count);
+        void DecodeRgbx(uint32_t* values, uint16_t* dest, uint32_t count);
+        // Raster decode of a width x height image that replaces values inconsistent with their neighbours
+        void DecodeConsistent(uint8_t* values, uint16_t* dest, uint32_t width, uint32_t height, uint32_t threshold = 1024,
+                              uint32_t pixelSize = 3);
 
         Color ValueToColor(uint16_t val);
         uint16_t ColorToValue(const Color& col);
@@ -25,11 +31,16 @@ namespace DStream
     private:
         Color Enlarge(Color col);
         Color Shrink(Color col);
+        // Point of the curve at index and its inverse
+        Color CurvePoint(uint32_t index);
+        uint32_t CurveIndex(Color point);
 
     private:
         uint32_t m_CurveBits;
         uint32_t m_SegmentBits;
         bool m_OptimizeSpacing;
+        // The last segment leaves the curve along this axis, away from the previous point
+        uint32_t m_LastAxis;
     };
 }
 
@@ -0,0 +1,168 @@
+#include <MedianFilter.h>
+#include <ThreadPool.h>
+
+#include <algorithm>
+#include <vector>
+
+// Compare-exchange of two rows of lanes, plain min / max loops the compiler turns into vector instructions
+#define SORT2(a, b) for (uint32_t l=0; l<s_Lanes; l++) \
+    { uint16_t lo = std::min(p[a][l], p[b][l]); p[b][l] = std::max(p[a][l], p[b][l]); p[a][l] = lo; }
+
+namespace DStream
+{
+    // Smallest row band worth a task of its own
+    static const uint32_t s_MinBandRows = 32;
+    // Pixels run through the sorting network together
+    static const uint32_t s_Lanes = 32;
+
+    // Median of 9 in 19 exchanges (Paeth / Devillard), ends up in p[4]
+    static inline void Median9(uint16_t (*p)[s_Lanes])
+    {
+        SORT2(1, 2); SORT2(4, 5); SORT2(7, 8); SORT2(0, 1); SORT2(3, 4); SORT2(6, 7);
+        SORT2(1, 2); SORT2(4, 5); SORT2(7, 8); SORT2(0, 3); SORT2(5, 8); SORT2(4, 7);
+        SORT2(3, 6); SORT2(1, 4); SORT2(2, 5); SORT2(4, 7); SORT2(4, 2); SORT2(6, 4);
+        SORT2(4, 2);
+    }
+
+    // Median of 25 in 99 exchanges (Devillard), ends up in p[12]
+    static inline void Median25(uint16_t (*p)[s_Lanes])
+    {
+        SORT2(0, 1);   SORT2(3, 4);   SORT2(2, 4);   SORT2(2, 3);   SORT2(6, 7);   SORT2(5, 7);
+        SORT2(5, 6);   SORT2(9, 10);  SORT2(8, 10);  SORT2(8, 9);   SORT2(12, 13); SORT2(11, 13);
+        SORT2(11, 12); SORT2(15, 16); SORT2(14, 16); SORT2(14, 15); SORT2(18, 19); SORT2(17, 19);
+        SORT2(17, 18); SORT2(21, 22); SORT2(20, 22); SORT2(20, 21); SORT2(23, 24); SORT2(2, 5);
+        SORT2(3, 6);   SORT2(0, 6);   SORT2(0, 3);   SORT2(4, 7);   SORT2(1, 7);   SORT2(1, 4);
+        SORT2(11, 14); SORT2(8, 14);  SORT2(8, 11);  SORT2(12, 15); SORT2(9, 15);  SORT2(9, 12);
+        SORT2(13, 16); SORT2(10, 16); SORT2(10, 13); SORT2(20, 23); SORT2(17, 23); SORT2(17, 20);
+        SORT2(21, 24); SORT2(18, 24); SORT2(18, 21); SORT2(19, 22); SORT2(8, 17);  SORT2(9, 18);
+        SORT2(0, 18);  SORT2(0, 9);   SORT2(10, 19); SORT2(1, 19);  SORT2(1, 10);  SORT2(11, 20);
+        SORT2(2, 20);  SORT2(2, 11);  SORT2(12, 21); SORT2(3, 21);  SORT2(3, 12);  SORT2(13, 22);
+        SORT2(4, 22);  SORT2(4, 13);  SORT2(14, 23); SORT2(5, 23);  SORT2(5, 14);  SORT2(15, 24);
+        SORT2(6, 24);  SORT2(6, 15);  SORT2(7, 16);  SORT2(7, 19);  SORT2(13, 21); SORT2(15, 23);
+        SORT2(7, 13);  SORT2(7, 15);  SORT2(1, 9);   SORT2(3, 11);  SORT2(5, 17);  SORT2(11, 17);
+        SORT2(9, 17);  SORT2(4, 10);  SORT2(6, 12);  SORT2(7, 14);  SORT2(4, 6);   SORT2(4, 7);
+        SORT2(12, 14); SORT2(10, 14); SORT2(6, 7);   SORT2(10, 12); SORT2(6, 10);  SORT2(6, 17);
+        SORT2(12, 17); SORT2(7, 17);  SORT2(7, 10);  SORT2(12, 18); SORT2(7, 12);  SORT2(10, 18);
+        SORT2(12, 20); SORT2(10, 20); SORT2(10, 12);
+    }
+
+    // Rows are padded by radius on the left and at least radius + s_Lanes on the right, so whole blocks can be read
+    template <uint32_t Window>
+    static void FilterRow(uint16_t* const* rows, uint16_t* dest, uint32_t width, uint32_t threshold)
+    {
+        const uint32_t radius = Window / 2;
+        uint16_t p[Window * Window][s_Lanes];
+
+        for (uint32_t x=0; x<width; x+=s_Lanes)
+        {
+            for (uint32_t i=0; i<Window; i++)
+                for (uint32_t j=0; j<Window; j++)
+                    std::copy(rows[i] + x + j, rows[i] + x + j + s_Lanes, p[i * Window + j]);
+
+            if (Window == 3)
+                Median9(p);
+            else
+                Median25(p);
+
+            const uint16_t* current = rows[radius] + x + radius;
+            const uint16_t* median = p[Window * Window / 2];
+            uint32_t n = std::min(s_Lanes, width - x);
+            for (uint32_t l=0; l<n; l++)
+            {
+                uint32_t distance = std::abs((int32_t)current[l] - (int32_t)median[l]);
+                dest[x + l] = distance > threshold ? median[l] : current[l];
+            }
+        }
+    }
+
+    // Filters rows [first, last). Rows are read from a ring of padded copies so the band can be overwritten in place;
+    // halo holds the original rows just outside the band, which another worker may be overwriting.
+    template <uint32_t Window>
+    static void FilterBand(uint16_t* data, uint32_t width, uint32_t height, uint32_t first, uint32_t last, uint32_t threshold,
+                           const std::vector<uint16_t>& halo)
+    {
+        const uint32_t radius = Window / 2;
+        const uint32_t stride = width + 2 * radius + s_Lanes;
+        std::vector<uint16_t> ring(stride * Window);
+        uint16_t* rows[Window];
+
+        // Original row y, clamped to the image and padded by replicating the edges
+        auto loadRow = [&](int32_t y, uint16_t* dest) {
+            y = std::min<int32_t>(std::max<int32_t>(y, 0), height - 1);
+            const uint16_t* src;
+            if (y < (int32_t)first)
+                src = halo.data() + (radius - (first - y)) * width;
+            else if (y >= (int32_t)last)
+                src = halo.data() + (radius + y - last) * width;
+            else
+                src = data + y * width;
+
+            std::copy(src, src + width, dest + radius);
+            std::fill(dest, dest + radius, src[0]);
+            std::fill(dest + radius + width, dest + stride, src[width - 1]);
+        };
+
+        for (uint32_t i=0; i<Window; i++)
+            loadRow((int32_t)first - radius + i, ring.data() + i * stride);
+
+        for (uint32_t y=first; y<last; y++)
+        {
+            uint32_t top = (y - first) % Window;
+            for (uint32_t i=0; i<Window; i++)
+                rows[i] = ring.data() + ((top + i) % Window) * stride;
+
+            FilterRow<Window>(rows, data + y * width, width, threshold);
+            // The oldest row slides out of the window
+            if (y + 1 < last)
+                loadRow(y + radius + 1, rows[0]);
+        }
+    }
+
+    bool MedianFilter(uint16_t* data, uint32_t width, uint32_t height, uint32_t window, uint32_t threshold, uint32_t nThreads)
+    {
+        if ((window != 3 && window != 5) || !width || !height)
+            return window == 3 || window == 5;
+
+        uint32_t radius = window / 2;
+        uint32_t nBands = std::max(1u, std::min(nThreads ? nThreads : std::max(1u, std::thread::hardware_concurrency()),
+                                                height / s_MinBandRows));
+        uint32_t bandRows = (height + nBands - 1) / nBands;
+        std::vector<std::vector<uint16_t>> halos(nBands);
+
+        // Save the rows around the band boundaries before anything is overwritten
+        for (uint32_t b=0; b<nBands; b++)
+        {
+            uint32_t first = std::min(height, b * bandRows), last = std::min(height, first + bandRows);
+            halos[b].resize(2 * radius * width);
+            for (uint32_t i=0; i<radius; i++)
+            {
+                uint32_t above = std::max<int32_t>((int32_t)first - radius + i, 0);
+                uint32_t below = std::min(last + i, height - 1);
+                std::copy(data + above * width, data + (above + 1) * width, halos[b].begin() + i * width);
+                std::copy(data + below * width, data + (below + 1) * width, halos[b].begin() + (radius + i) * width);
+            }
+        }
+
+        auto filterBand = [=, &halos](uint32_t b) {
+            uint32_t first = std::min(height, b * bandRows), last = std::min(height, first + bandRows);
+            if (first >= last)
+                return;
+            if (window == 3)
+                FilterBand<3>(data, width, height, first, last, threshold, halos[b]);
+            else
+                FilterBand<5>(data, width, height, first, last, threshold, halos[b]);
+        };
+
+        if (nBands == 1)
+            filterBand(0);
+        else
+        {
+            ThreadPool pool(nBands);
+            for (uint32_t b=0; b<nBands; b++)
+                pool.Submit([&filterBand, b]() { filterBand(b); });
+            pool.Wait();
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef MEDIANFILTER_H
+#define MEDIANFILTER_H
+
+#include <cstdint>
+
+namespace DStream
+{
+    // Post-decode spike removal: every pixel further than threshold from the median of its window x window
+    // neighbourhood is replaced by that median (threshold 0 is a plain median filter). Window is 3 or 5, borders
+    // replicate the edge pixels. Works in place, bands of rows are filtered by nThreads workers (0 uses every core).
+    // Returns false for an unsupported window.
+    bool MedianFilter(uint16_t* data, uint32_t width, uint32_t height, uint32_t window, uint32_t threshold = 0,
+                      uint32_t nThreads = 0);
+}
+
+#endif // MEDIANFILTER_H
@@ -1,4 +1,6 @@
 #include <MortonCoder.h>
+#include <RgbxLayout.h>
+#include <ConsistentDecoder.h>
 // Credits for Morton convertions: https://github.com/davemc0/DMcTools/blob/main/Math/SpaceFillCurve.h
 
 namespace DStream
@@ -25,10 +27,28 @@ namespace DStream
         }
     }
 
+    void MortonCoder::EncodeRgbx(uint16_t* values, uint32_t* dest, uint32_t count)
+    {
+        DStream::EncodeRgbx(*this, values, dest, count);
+    }
+
+    void MortonCoder::DecodeRgbx(uint32_t* values, uint16_t* dest, uint32_t count)
+    {
+        DStream::DecodeRgbx(*this, values, dest, count);
+    }
+
+    void MortonCoder::DecodeConsistent(uint8_t* values, uint16_t* dest, uint32_t width, uint32_t height, uint32_t threshold,
+                                       uint32_t pixelSize)
+    {
+        // Morton colours use the low bits of each channel, candidates are spaced by about the JPEG noise amplitude
+        DStream::DecodeConsistent(*this, values, dest, width, height, 4, threshold, pixelSize);
+    }
+
     Color MortonCoder::ValueToColor(uint16_t val)
     {
         Color ret;
         ret[0] = 0; ret[1] = 0; ret[2] = 0;
+        val >>= 16 - m_Quantization;
 
         for (unsigned int i = 0; i <= m_CurveBits; ++i) {
             uint8_t selector = 1;
@@ -54,7 +74,7 @@ namespace DStream
             codez |= (int)(col.z & andbit) << i;
         }
 
-        return ((codez << 2) | (codey << 1) | codex);
+        return ((codez << 2) | (codey << 1) | codex) << (16 - m_Quantization);
     }
 }
 
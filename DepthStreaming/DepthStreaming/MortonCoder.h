@@ -12,6 +12,12 @@ namespace DStream
         MortonCoder(uint32_t q, uint32_t curveBits);
         void Encode(uint16_t* values, uint8_t* dest, uint32_t count);
         void Decode(uint8_t* values, uint16_t* dest, uint32_t count);
+        // 4 byte RGBX pixels, see RgbxLayout.h
+        void EncodeRgbx(uint16_t* values, uint32_t* dest, uint32_t count);
+        void DecodeRgbx(uint32_t* values, uint16_t* dest, uint32_t count);
+        // Raster decode of a width x height image that replaces values inconsistent with their neighbours
+        void DecodeConsistent(uint8_t* values, uint16_t* dest, uint32_t width, uint32_t height, uint32_t threshold = 1024,
+                              uint32_t pixelSize = 3);
 
         Color ValueToColor(uint16_t val);
         uint16_t ColorToValue(const Color& col);
@@ -1,4 +1,5 @@
 #include "PackedCoder.h"
+#include <RgbxLayout.h>
 
 namespace DStream
 {
@@ -24,6 +25,16 @@ namespace DStream
         }
     }
 
+    void PackedCoder::EncodeRgbx(uint16_t* values, uint32_t* dest, uint32_t count)
+    {
+        DStream::EncodeRgbx(*this, values, dest, count);
+    }
+
+    void PackedCoder::DecodeRgbx(uint32_t* values, uint16_t* dest, uint32_t count)
+    {
+        DStream::DecodeRgbx(*this, values, dest, count);
+    }
+
     Color PackedCoder::ValueToColor(uint16_t val)
     {
         Color ret;
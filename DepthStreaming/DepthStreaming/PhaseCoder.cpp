@@ -1,4 +1,5 @@
 #include <PhaseCoder.h>
+#include <RgbxLayout.h>
 #include <cmath>
 // Credits for Morton convertions: https://github.com/davemc0/DMcTools/blob/main/Math/SpaceFillCurve.h
 
@@ -26,6 +27,16 @@ namespace DStream
         }
     }
 
+    void PhaseCoder::EncodeRgbx(uint16_t* values, uint32_t* dest, uint32_t count)
+    {
+        DStream::EncodeRgbx(*this, values, dest, count);
+    }
+
+    void PhaseCoder::DecodeRgbx(uint32_t* values, uint16_t* dest, uint32_t count)
+    {
+        DStream::DecodeRgbx(*this, values, dest, count);
+    }
+
     Color PhaseCoder::ValueToColor(uint16_t val)
     {
         Color ret;
@@ -0,0 +1,205 @@
+#include <PngEncoder.h>
+#include <ThreadPool.h>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+namespace DStream
+{
+    // Uncompressed bytes per deflate chunk, small enough to keep every thread busy on a few megapixels
+    static const size_t s_ChunkSize = 1 << 20;
+    static const size_t s_WindowSize = 32768;
+
+    const char* PngFilterName(PngFilter filter)
+    {
+        switch (filter)
+        {
+        case NONE: return "None";
+        case SUB: return "Sub";
+        case UP: return "Up";
+        case AVERAGE: return "Average";
+        case PAETH: return "Paeth";
+        case ADAPTIVE: return "Adaptive";
+        default: return "Unknown";
+        }
+    }
+
+    static inline uint8_t Paeth(int a, int b, int c)
+    {
+        int p = a + b - c;
+        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc)
+            return a;
+        return pb <= pc ? b : c;
+    }
+
+    // Filters one row into dest (without the filter type byte), prev is null for the first row
+    static void FilterRow(PngFilter filter, const uint8_t* row, const uint8_t* prev, uint32_t size, uint32_t bpp, uint8_t* dest)
+    {
+        for (uint32_t i=0; i<size; i++)
+        {
+            int a = i >= bpp ? row[i - bpp] : 0;
+            int b = prev ? prev[i] : 0;
+            int c = (prev && i >= bpp) ? prev[i - bpp] : 0;
+
+            switch (filter)
+            {
+            case SUB: dest[i] = row[i] - a; break;
+            case UP: dest[i] = row[i] - b; break;
+            case AVERAGE: dest[i] = row[i] - ((a + b) >> 1); break;
+            case PAETH: dest[i] = row[i] - Paeth(a, b, c); break;
+            default: dest[i] = row[i]; break;
+            }
+        }
+    }
+
+    static uint32_t FilterCost(const uint8_t* filtered, uint32_t size)
+    {
+        uint32_t ret = 0;
+        for (uint32_t i=0; i<size; i++)
+            ret += std::abs((int8_t)filtered[i]);
+        return ret;
+    }
+
+    static void PushU32(std::vector<uint8_t>& dest, uint32_t value)
+    {
+        for (int shift=24; shift>=0; shift-=8)
+            dest.push_back((value >> shift) & 0xFF);
+    }
+
+    static void PushChunk(std::vector<uint8_t>& dest, const char* type, const uint8_t* data, size_t size)
+    {
+        PushU32(dest, size);
+        size_t start = dest.size();
+        dest.insert(dest.end(), type, type + 4);
+        dest.insert(dest.end(), data, data + size);
+        PushU32(dest, crc32(0, dest.data() + start, size + 4));
+    }
+
+    PngEncoder::PngEncoder(uint32_t nThreads/* = 0*/) : m_Threads(nThreads) {}
+
+    bool PngEncoder::Encode(const uint8_t* data, uint32_t width, uint32_t height, uint32_t channels, std::vector<uint8_t>& dest)
+    {
+        if (!width || !height || (channels != 1 && channels != 3 && channels != 4))
+            return false;
+
+        size_t rowSize = (size_t)width * channels;
+        size_t lineSize = rowSize + 1;
+        std::vector<uint8_t> filtered(lineSize * height);
+
+        uint32_t rowsPerChunk = std::max<size_t>(1, s_ChunkSize / lineSize);
+        uint32_t nChunks = (height + rowsPerChunk - 1) / rowsPerChunk;
+        std::vector<std::vector<uint8_t>> compressed(nChunks);
+        std::vector<uLong> adlers(nChunks);
+        std::atomic<bool> failed(false);
+        ThreadPool pool(std::min(nChunks, m_Threads ? m_Threads : std::max(1u, std::thread::hardware_concurrency())));
+
+        // Filtering only reads the unfiltered input, every row is independent
+        for (uint32_t c=0; c<nChunks; c++)
+        {
+            pool.Submit([&, c]() {
+                std::vector<uint8_t> candidate(rowSize);
+                uint32_t last = std::min(height, (c + 1) * rowsPerChunk);
+                for (uint32_t y=c*rowsPerChunk; y<last; y++)
+                {
+                    const uint8_t* row = data + y * rowSize;
+                    const uint8_t* prev = y ? row - rowSize : nullptr;
+                    uint8_t* line = filtered.data() + y * lineSize;
+                    PngFilter filter = m_Filter;
+
+                    if (filter == ADAPTIVE)
+                    {
+                        uint32_t bestCost = UINT32_MAX;
+                        for (uint32_t f=NONE; f<=PAETH; f++)
+                        {
+                            FilterRow((PngFilter)f, row, prev, rowSize, channels, candidate.data());
+                            uint32_t cost = FilterCost(candidate.data(), rowSize);
+                            if (cost < bestCost)
+                            {
+                                bestCost = cost;
+                                filter = (PngFilter)f;
+                            }
+                        }
+                    }
+
+                    line[0] = filter;
+                    FilterRow(filter, row, prev, rowSize, channels, line + 1);
+                }
+            });
+        }
+        pool.Wait();
+
+        // Raw deflate of every chunk, the last one closes the stream
+        for (uint32_t c=0; c<nChunks; c++)
+        {
+            pool.Submit([&, c]() {
+                size_t start = c * rowsPerChunk * lineSize;
+                size_t size = std::min<size_t>(filtered.size(), (c + 1) * rowsPerChunk * lineSize) - start;
+                std::vector<uint8_t>& out = compressed[c];
+                z_stream stream;
+                memset(&stream, 0, sizeof(stream));
+
+                if (deflateInit2(&stream, m_Level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                {
+                    failed = true;
+                    return;
+                }
+                if (c > 0)
+                {
+                    size_t dictSize = std::min(start, s_WindowSize);
+                    deflateSetDictionary(&stream, filtered.data() + start - dictSize, dictSize);
+                }
+
+                out.resize(deflateBound(&stream, size) + 16);
+                stream.next_in = filtered.data() + start;
+                stream.avail_in = size;
+                stream.next_out = out.data();
+                stream.avail_out = out.size();
+
+                int flush = c + 1 == nChunks ? Z_FINISH : Z_SYNC_FLUSH;
+                int ret = deflate(&stream, flush);
+                if ((flush == Z_FINISH && ret != Z_STREAM_END) || (flush != Z_FINISH && ret != Z_OK) || stream.avail_in)
+                    failed = true;
+
+                out.resize(out.size() - stream.avail_out);
+                adlers[c] = adler32(1, filtered.data() + start, size);
+                deflateEnd(&stream);
+            });
+        }
+        pool.Wait();
+        if (failed)
+            return false;
+
+        // zlib stream: header, concatenated chunks, Adler-32 of the whole filtered data
+        std::vector<uint8_t> zlibData = {0x78, 0x9C};
+        uLong adler = adlers[0];
+        for (uint32_t c=0; c<nChunks; c++)
+        {
+            zlibData.insert(zlibData.end(), compressed[c].begin(), compressed[c].end());
+            if (c > 0)
+            {
+                size_t size = std::min<size_t>(filtered.size(), (c + 1) * rowsPerChunk * lineSize) - c * rowsPerChunk * lineSize;
+                adler = adler32_combine(adler, adlers[c], size);
+            }
+        }
+        PushU32(zlibData, adler);
+
+        static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        std::vector<uint8_t> header;
+        PushU32(header, width);
+        PushU32(header, height);
+        header.push_back(8);
+        header.push_back(channels == 1 ? 0 : (channels == 3 ? 2 : 6));
+        header.insert(header.end(), {0, 0, 0});
+
+        dest.assign(signature, signature + 8);
+        PushChunk(dest, "IHDR", header.data(), header.size());
+        PushChunk(dest, "IDAT", zlibData.data(), zlibData.size());
+        PushChunk(dest, "IEND", nullptr, 0);
+        return true;
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef PNGENCODER_H
+#define PNGENCODER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace DStream
+{
+    // PNG row filters, ADAPTIVE picks the one with the smallest sum of absolute residuals for every row
+    enum PngFilter { NONE = 0, SUB, UP, AVERAGE, PAETH, ADAPTIVE };
+
+    const char* PngFilterName(PngFilter filter);
+
+    // 8 bit PNG encoder for coder output. Rows are filtered and deflated in independent chunks on several threads,
+    // pigz-style: each chunk is primed with the last 32K of the previous one and ends on a byte boundary, so the
+    // chunks concatenate into a single valid zlib stream.
+    class PngEncoder
+    {
+    public:
+        PngEncoder(uint32_t nThreads = 0);
+
+        // 1 (grey), 3 (RGB) or 4 (RGBA) interleaved channels
+        bool Encode(const uint8_t* data, uint32_t width, uint32_t height, uint32_t channels, std::vector<uint8_t>& dest);
+
+        inline void SetFilter(PngFilter filter) {m_Filter = filter;}
+        inline void SetCompressionLevel(int level) {m_Level = level;}
+        inline void SetThreads(uint32_t nThreads) {m_Threads = nThreads;}
+
+    private:
+        PngFilter m_Filter = ADAPTIVE;
+        int m_Level = 6;
+        uint32_t m_Threads;
+    };
+}
+
+#endif // PNGENCODER_H
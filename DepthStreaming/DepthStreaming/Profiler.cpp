@@ -0,0 +1,172 @@
+#include <Profiler.h>
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#endif
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
+namespace DStream
+{
+    const char* StageName(Stage stage)
+    {
+        switch (stage)
+        {
+        case PARSING: return "Parsing";
+        case CODER_ENCODE: return "CoderEncode";
+        case JPEG_ENCODE: return "JpegEncode";
+        case JPEG_DECODE: return "JpegDecode";
+        case CODER_DECODE: return "CoderDecode";
+        case POST_FILTER: return "PostFilter";
+        case ERROR_ANALYSIS: return "ErrorAnalysis";
+        default: return "Unknown";
+        }
+    }
+
+    StageTimer::StageTimer(StageStats& stats, size_t pixels/* = 0*/, size_t bytes/* = 0*/, bool concurrent/* = false*/)
+        : m_Stats(stats), m_Concurrent(concurrent)
+    {
+        m_Stats.Pixels += pixels;
+        m_Stats.Bytes += bytes;
+
+        m_PeakReset = !m_Concurrent && ResetPeakRss();
+        m_RssStart = m_Concurrent ? 0 : CurrentRssKB();
+        m_PeakStart = m_Concurrent ? 0 : PeakRssKB();
+        m_CpuStart = m_Concurrent ? ThreadCpuTimeNs() : ProcessCpuTimeNs();
+        m_WallStart = std::chrono::steady_clock::now();
+    }
+
+    StageTimer::~StageTimer()
+    {
+        auto wallEnd = std::chrono::steady_clock::now();
+        uint64_t cpuEnd = m_Concurrent ? ThreadCpuTimeNs() : ProcessCpuTimeNs();
+
+        m_Stats.WallNs += std::chrono::duration_cast<std::chrono::nanoseconds>(wallEnd - m_WallStart).count();
+        m_Stats.CpuNs += cpuEnd - m_CpuStart;
+        if (m_Concurrent)
+            return;
+
+        size_t peak = PeakRssKB();
+        if (!m_PeakReset && peak <= m_PeakStart)
+            peak = std::max(m_RssStart, CurrentRssKB());
+        m_Stats.PeakRssKB = std::max(m_Stats.PeakRssKB, peak);
+    }
+
+    uint64_t ThreadCpuTimeNs()
+    {
+#ifdef _WIN32
+        FILETIME creation, exit, kernel, user;
+        GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+        uint64_t k = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+        uint64_t u = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+        // FILETIME is in 100ns units
+        return (k + u) * 100;
+#else
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+    }
+
+    uint64_t ProcessCpuTimeNs()
+    {
+#ifdef _WIN32
+        FILETIME creation, exit, kernel, user;
+        GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+        uint64_t k = ((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime;
+        uint64_t u = ((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime;
+        return (k + u) * 100;
+#else
+        timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+    }
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+    // Field of /proc/self/status in kB, 0 if it can't be read
+    static size_t ProcStatusKB(const char* field)
+    {
+        FILE* status = fopen("/proc/self/status", "r");
+        if (!status)
+            return 0;
+
+        char line[256];
+        size_t ret = 0;
+        size_t length = strlen(field);
+        while (fgets(line, sizeof(line), status))
+        {
+            if (!strncmp(line, field, length) && line[length] == ':')
+            {
+                ret = strtoull(line + length + 1, nullptr, 10);
+                break;
+            }
+        }
+        fclose(status);
+        return ret;
+    }
+#endif
+
+    size_t CurrentRssKB()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+        return counters.WorkingSetSize / 1024;
+#elif defined(__APPLE__)
+        mach_task_basic_info info;
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+        if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+            return 0;
+        return info.resident_size / 1024;
+#else
+        return ProcStatusKB("VmRSS");
+#endif
+    }
+
+    size_t PeakRssKB()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+        return counters.PeakWorkingSetSize / 1024;
+#else
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        // Reported in bytes on macOS, kilobytes everywhere else
+        return usage.ru_maxrss / 1024;
+#else
+        // ru_maxrss isn't affected by ResetPeakRss, VmHWM is
+        size_t hwm = ProcStatusKB("VmHWM");
+        return hwm ? hwm : usage.ru_maxrss;
+#endif
+#endif
+    }
+
+    bool ResetPeakRss()
+    {
+#if defined(_WIN32) || defined(__APPLE__)
+        return false;
+#else
+        // 5 resets the peak RSS of the process to its current RSS (Linux 4.0+)
+        FILE* clearRefs = fopen("/proc/self/clear_refs", "w");
+        if (!clearRefs)
+            return false;
+        bool ok = fputs("5", clearRefs) >= 0;
+        ok = fclose(clearRefs) == 0 && ok;
+        return ok && ProcStatusKB("VmHWM") > 0;
+#endif
+    }
+}
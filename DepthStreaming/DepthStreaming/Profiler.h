@@ -0,0 +1,61 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+
+namespace DStream
+{
+    enum Stage { PARSING = 0, CODER_ENCODE, JPEG_ENCODE, JPEG_DECODE, CODER_DECODE, POST_FILTER, ERROR_ANALYSIS, STAGE_COUNT };
+
+    const char* StageName(Stage stage);
+
+    struct StageStats
+    {
+        uint64_t WallNs = 0;
+        uint64_t CpuNs = 0;
+        // 0 when it wasn't measured
+        size_t PeakRssKB = 0;
+
+        // Work processed by the stage, used for the throughput figures
+        size_t Pixels = 0;
+        size_t Bytes = 0;
+
+        inline double NsPerPixel() const {return Pixels ? (double)WallNs / Pixels : 0.0;}
+        inline double MBps() const {return WallNs ? (Bytes / (1024.0 * 1024.0)) / (WallNs * 1e-9) : 0.0;}
+        inline double Mpixps() const {return WallNs ? (Pixels * 1e-6) / (WallNs * 1e-9) : 0.0;}
+    };
+
+    // Adds the wall and CPU time spent between construction and destruction to a stage. CPU time is the process one, so
+    // the work a stage hands to pool workers is counted. Peak RSS is the highest resident set size of the process during
+    // the stage: where the high-water mark can be reset (Linux) it restarts when the stage starts, elsewhere it is the
+    // high-water mark if the stage raised it, else the larger of the RSS at the start and the end.
+    // Concurrent stages (-g grid points, one per worker) only count the CPU time of the calling thread, and leave the
+    // peak RSS unmeasured: it is process wide, and resetting it would hide the peaks of the other stages.
+    class StageTimer
+    {
+    public:
+        StageTimer(StageStats& stats, size_t pixels = 0, size_t bytes = 0, bool concurrent = false);
+        ~StageTimer();
+
+    private:
+        StageStats& m_Stats;
+        std::chrono::steady_clock::time_point m_WallStart;
+        bool m_Concurrent;
+        uint64_t m_CpuStart;
+        bool m_PeakReset;
+        size_t m_RssStart;
+        size_t m_PeakStart;
+    };
+
+    uint64_t ThreadCpuTimeNs();
+    uint64_t ProcessCpuTimeNs();
+    size_t CurrentRssKB();
+    // High-water mark of the resident set size
+    size_t PeakRssKB();
+    // Restarts the high-water mark from the current RSS, false where it can't be reset
+    bool ResetPeakRss();
+}
+
+#endif // PROFILER_H
@@ -0,0 +1,191 @@
+#include <RateDistortion.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <fstream>
+
+namespace DStream
+{
+    // Polynomial in (x - Center), lowest degree first
+    struct Fit
+    {
+        double Center = 0.0;
+        double MinX = 0.0;
+        double MaxX = 0.0;
+        std::vector<double> Coefficients;
+
+        double Integral(double from, double to) const
+        {
+            double ret = 0.0;
+            for (size_t k=0; k<Coefficients.size(); k++)
+                ret += Coefficients[k] / (k + 1) * (std::pow(to - Center, k + 1) - std::pow(from - Center, k + 1));
+            return ret;
+        }
+    };
+
+    // Least squares fit of log(bpp) over PSNR, up to a cubic
+    static bool FitCurve(const RDCurve& curve, Fit& fit)
+    {
+        std::vector<double> x, y;
+        for (auto& p : curve.Points)
+        {
+            if (std::isfinite(p.Psnr) && p.Bpp > 0.0)
+            {
+                x.push_back(p.Psnr);
+                y.push_back(std::log(p.Bpp));
+            }
+        }
+        if (x.size() < 2)
+            return false;
+
+        fit.MinX = *std::min_element(x.begin(), x.end());
+        fit.MaxX = *std::max_element(x.begin(), x.end());
+        if (fit.MaxX - fit.MinX <= 0.0)
+            return false;
+        fit.Center = (fit.MinX + fit.MaxX) / 2.0;
+
+        // Normal equations, solved by Gaussian elimination with partial pivoting
+        uint32_t n = std::min<size_t>(4, x.size());
+        std::vector<std::vector<double>> m(n, std::vector<double>(n + 1, 0.0));
+        for (size_t i=0; i<x.size(); i++)
+        {
+            double dx = x[i] - fit.Center;
+            for (uint32_t r=0; r<n; r++)
+            {
+                for (uint32_t c=0; c<n; c++)
+                    m[r][c] += std::pow(dx, r + c);
+                m[r][n] += std::pow(dx, r) * y[i];
+            }
+        }
+
+        for (uint32_t c=0; c<n; c++)
+        {
+            uint32_t pivot = c;
+            for (uint32_t r=c+1; r<n; r++)
+                if (std::abs(m[r][c]) > std::abs(m[pivot][c]))
+                    pivot = r;
+            if (std::abs(m[pivot][c]) < 1e-12)
+                return false;
+            std::swap(m[c], m[pivot]);
+
+            for (uint32_t r=0; r<n; r++)
+            {
+                if (r == c)
+                    continue;
+                double factor = m[r][c] / m[c][c];
+                for (uint32_t k=c; k<=n; k++)
+                    m[r][k] -= factor * m[c][k];
+            }
+        }
+
+        fit.Coefficients.resize(n);
+        for (uint32_t c=0; c<n; c++)
+            fit.Coefficients[c] = m[c][n] / m[c][c];
+        return true;
+    }
+
+    double BDRate(const RDCurve& reference, const RDCurve& test)
+    {
+        Fit refFit, testFit;
+        if (!FitCurve(reference, refFit) || !FitCurve(test, testFit))
+            return std::numeric_limits<double>::quiet_NaN();
+
+        double from = std::max(refFit.MinX, testFit.MinX);
+        double to = std::min(refFit.MaxX, testFit.MaxX);
+        if (to <= from)
+            return std::numeric_limits<double>::quiet_NaN();
+
+        double avgDiff = (testFit.Integral(from, to) - refFit.Integral(from, to)) / (to - from);
+        return (std::exp(avgDiff) - 1.0) * 100.0;
+    }
+
+    bool WriteRDCsv(const std::string& path, const std::vector<RDCurve>& curves)
+    {
+        std::ofstream out(path, std::ios::out);
+        if (!out.is_open())
+            return false;
+
+        out << "Name,Quality,Bytes,Bpp,Rmse,Psnr,Max" << std::endl;
+        for (auto& curve : curves)
+            for (auto& p : curve.Points)
+                out << curve.Name << "," << p.Quality << "," << p.Bytes << "," << p.Bpp << "," << p.Rmse << "," << p.Psnr << ","
+                    << p.MaxErr << std::endl;
+        return out.good();
+    }
+
+    bool WriteBDRateCsv(const std::string& path, const std::vector<RDCurve>& curves)
+    {
+        std::ofstream out(path, std::ios::out);
+        if (!out.is_open())
+            return false;
+
+        out << "Reference";
+        for (auto& curve : curves)
+            out << "," << curve.Name;
+        out << std::endl;
+
+        for (auto& reference : curves)
+        {
+            out << reference.Name;
+            for (auto& test : curves)
+            {
+                double bd = BDRate(reference, test);
+                out << ",";
+                if (!std::isnan(bd))
+                    out << bd;
+            }
+            out << std::endl;
+        }
+        return out.good();
+    }
+
+    // JSON has no NaN or infinity, both are written as null
+    static void WriteJsonNumber(std::ostream& out, double value)
+    {
+        if (std::isfinite(value))
+            out << value;
+        else
+            out << "null";
+    }
+
+    bool WriteRDJson(const std::string& path, const std::vector<RDCurve>& curves)
+    {
+        std::ofstream out(path, std::ios::out);
+        if (!out.is_open())
+            return false;
+
+        out << "{" << std::endl << "    \"curves\": [" << std::endl;
+        for (size_t c=0; c<curves.size(); c++)
+        {
+            out << "        {\"name\": \"" << curves[c].Name << "\", \"points\": [";
+            for (size_t i=0; i<curves[c].Points.size(); i++)
+            {
+                const RDPoint& p = curves[c].Points[i];
+                out << (i ? ", " : "") << "{\"quality\": " << p.Quality << ", \"bytes\": " << p.Bytes << ", \"bpp\": " << p.Bpp
+                    << ", \"rmse\": " << p.Rmse << ", \"psnr\": ";
+                WriteJsonNumber(out, p.Psnr);
+                out << ", \"max\": " << p.MaxErr << "}";
+            }
+            out << "]}" << (c + 1 < curves.size() ? "," : "") << std::endl;
+        }
+
+        out << "    ]," << std::endl << "    \"bdRate\": [" << std::endl;
+        bool first = true;
+        for (auto& reference : curves)
+        {
+            for (auto& test : curves)
+            {
+                if (&reference == &test)
+                    continue;
+                out << (first ? "" : ",\n") << "        {\"reference\": \"" << reference.Name << "\", \"test\": \"" << test.Name
+                    << "\", \"bdRate\": ";
+                WriteJsonNumber(out, BDRate(reference, test));
+                out << "}";
+                first = false;
+            }
+        }
+        out << std::endl << "    ]" << std::endl << "}" << std::endl;
+        return out.good();
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef RATEDISTORTION_H
+#define RATEDISTORTION_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+
+namespace DStream
+{
+    struct RDPoint
+    {
+        uint32_t Quality;
+        size_t Bytes;
+        double Bpp;
+        double Rmse;
+        double Psnr;
+        uint32_t MaxErr;
+    };
+
+    // Rate-distortion curve of a single coder configuration, one point per JPEG quality
+    struct RDCurve
+    {
+        std::string Name;
+        std::vector<RDPoint> Points;
+    };
+
+    // Bjøntegaard-delta rate: average bitrate difference, in percent, of test with respect to reference at the same
+    // PSNR. Negative values mean test needs fewer bytes. Each curve is fitted with a cubic of log(rate) over PSNR and
+    // the fits are integrated on the overlapping PSNR interval. Returns NaN if the curves don't overlap or have
+    // less than two finite points.
+    double BDRate(const RDCurve& reference, const RDCurve& test);
+
+    // Curves as "Name,Quality,Bytes,Bpp,Rmse,Psnr,Max" rows, BD-rate as a matrix with reference rows and test columns
+    bool WriteRDCsv(const std::string& path, const std::vector<RDCurve>& curves);
+    bool WriteBDRateCsv(const std::string& path, const std::vector<RDCurve>& curves);
+    // Curves and every BD-rate pair in one document
+    bool WriteRDJson(const std::string& path, const std::vector<RDCurve>& curves);
+}
+
+#endif // RATEDISTORTION_H
@@ -0,0 +1,38 @@
+#ifndef RGBXLAYOUT_H
+#define RGBXLAYOUT_H
+
+#include <Vec3.h>
+
+#include <cstdint>
+
+namespace DStream
+{
+    // 4 byte pixels laid out as R, G, B, X (JCS_EXT_RGBX, QImage::Format_RGBX8888). Every pixel is a single aligned
+    // 32 bit word, written and read with one store / load instead of three byte accesses. Words are composed for
+    // little endian targets.
+    inline uint32_t PackRgbx(const Color& c)
+    {
+        return c.x | (c.y << 8) | (c.z << 16) | 0xFF000000u;
+    }
+
+    inline Color UnpackRgbx(uint32_t word)
+    {
+        return {(uint8_t)word, (uint8_t)(word >> 8), (uint8_t)(word >> 16)};
+    }
+
+    template <typename Coder>
+    void EncodeRgbx(Coder& coder, const uint16_t* values, uint32_t* dest, uint32_t count)
+    {
+        for (uint32_t i=0; i<count; i++)
+            dest[i] = PackRgbx(coder.ValueToColor(values[i]));
+    }
+
+    template <typename Coder>
+    void DecodeRgbx(Coder& coder, const uint32_t* values, uint16_t* dest, uint32_t count)
+    {
+        for (uint32_t i=0; i<count; i++)
+            dest[i] = coder.ColorToValue(UnpackRgbx(values[i]));
+    }
+}
+
+#endif // RGBXLAYOUT_H
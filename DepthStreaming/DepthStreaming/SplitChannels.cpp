@@ -0,0 +1,77 @@
+#include <SplitChannels.h>
+#include <jpeg_encoder.h>
+#include <jpeg_decoder.h>
+
+#include <cstring>
+
+namespace DStream
+{
+    bool EncodeSplitChannels(const uint8_t* data, uint32_t width, uint32_t height, uint32_t pixelSize,
+                             const std::vector<uint32_t>& qualities, bool progressive, std::vector<std::vector<uint8_t>>& dest)
+    {
+        uint32_t nElements = width * height;
+        std::vector<uint8_t> channel(nElements);
+
+        dest.resize(qualities.size());
+        for (uint32_t c=0; c<qualities.size(); c++)
+        {
+            JpegEncoder encoder;
+            uint8_t* buffer = nullptr;
+            int length = 0;
+
+            for (uint32_t i=0; i<nElements; i++)
+                channel[i] = data[i * pixelSize + c];
+
+            encoder.setColorSpace(J_COLOR_SPACE::JCS_GRAYSCALE, 1);
+            encoder.setJpegColorSpace(J_COLOR_SPACE::JCS_GRAYSCALE);
+            encoder.setQuality(qualities[c]);
+            encoder.setProgressive(progressive);
+            if (!encoder.encode(channel.data(), width, height, buffer, length))
+                return false;
+
+            dest[c].assign(buffer, buffer + length);
+            free(buffer);
+        }
+
+        return true;
+    }
+
+    bool DecodeSplitChannels(std::vector<std::vector<uint8_t>>& jpegs, uint8_t* dest, uint32_t width, uint32_t height,
+                             uint32_t pixelSize)
+    {
+        uint32_t nElements = width * height;
+
+        memset(dest, 0, nElements * pixelSize);
+        for (uint32_t c=0; c<jpegs.size(); c++)
+        {
+            JpegDecoder decoder;
+            uint8_t* channel = nullptr;
+            int decodedWidth, decodedHeight;
+
+            decoder.setColorSpace(J_COLOR_SPACE::JCS_GRAYSCALE);
+            decoder.setJpegColorSpace(J_COLOR_SPACE::JCS_GRAYSCALE);
+            if (!decoder.decode(jpegs[c].data(), jpegs[c].size(), channel, decodedWidth, decodedHeight) ||
+                (uint32_t)decodedWidth != width || (uint32_t)decodedHeight != height)
+            {
+                delete[] channel;
+                return false;
+            }
+
+            for (uint32_t i=0; i<nElements; i++)
+                dest[i * pixelSize + c] = channel[i];
+            delete[] channel;
+        }
+
+        return true;
+    }
+
+    std::string SplitChannelPath(const std::string& path, uint32_t channel)
+    {
+        size_t dot = path.find_last_of('.');
+        size_t slash = path.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            dot = path.size();
+
+        return path.substr(0, dot) + "_c" + std::to_string(channel) + path.substr(dot);
+    }
+}
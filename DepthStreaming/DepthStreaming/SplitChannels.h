@@ -0,0 +1,23 @@
+#ifndef SPLITCHANNELS_H
+#define SPLITCHANNELS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace DStream
+{
+    // Channels of the encoded data stored as separate single component JPEGs, so the channels a coder leaves empty
+    // aren't compressed and each one gets its own quality. Channel c of the pixelSize byte pixels is compressed at
+    // qualities[c], the channels past qualities.size() are dropped.
+    bool EncodeSplitChannels(const uint8_t* data, uint32_t width, uint32_t height, uint32_t pixelSize,
+                             const std::vector<uint32_t>& qualities, bool progressive, std::vector<std::vector<uint8_t>>& dest);
+    // Reassembles the pixelSize byte pixels from the channel JPEGs, the dropped channels are set to 0. dest holds
+    // width x height pixels.
+    bool DecodeSplitChannels(std::vector<std::vector<uint8_t>>& jpegs, uint8_t* dest, uint32_t width, uint32_t height,
+                             uint32_t pixelSize);
+    // File of a channel JPEG: the channel index is appended to the name, "out.jpg" -> "out_c0.jpg"
+    std::string SplitChannelPath(const std::string& path, uint32_t channel);
+}
+
+#endif // SPLITCHANNELS_H
@@ -0,0 +1,74 @@
+#include <ThreadPool.h>
+
+#include <algorithm>
+
+namespace DStream
+{
+    ThreadPool::ThreadPool(uint32_t nThreads, size_t memoryBudget) : m_MemoryBudget(memoryBudget)
+    {
+        if (nThreads == 0)
+            nThreads = std::max(1u, std::thread::hardware_concurrency());
+
+        for (uint32_t i=0; i<nThreads; i++)
+            m_Workers.emplace_back(&ThreadPool::Work, this);
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+        }
+        m_StateChanged.notify_all();
+
+        for (auto& worker : m_Workers)
+            worker.join();
+    }
+
+    void ThreadPool::Submit(const std::function<void()>& task, size_t memory/* = 0*/)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Tasks.push_back({task, memory});
+        }
+        m_StateChanged.notify_all();
+    }
+
+    void ThreadPool::Wait()
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_StateChanged.wait(lock, [this]{ return m_Tasks.empty() && m_Running == 0; });
+    }
+
+    void ThreadPool::Work()
+    {
+        while (true)
+        {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_StateChanged.wait(lock, [this]{
+                    return m_Stop || (!m_Tasks.empty() &&
+                                      (m_Running == 0 || m_MemoryInUse + m_Tasks.front().Memory <= m_MemoryBudget));
+                });
+
+                if (m_Tasks.empty())
+                    return;
+
+                task = std::move(m_Tasks.front());
+                m_Tasks.pop_front();
+                m_MemoryInUse += task.Memory;
+                m_Running++;
+            }
+
+            task.Function();
+
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_MemoryInUse -= task.Memory;
+                m_Running--;
+            }
+            m_StateChanged.notify_all();
+        }
+    }
+}
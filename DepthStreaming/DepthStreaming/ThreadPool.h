@@ -0,0 +1,54 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace DStream
+{
+    // Fixed set of workers running tasks in submission order. Each task declares how much memory it needs and is
+    // only started when it fits in the budget together with the running ones (a task is never blocked if it runs alone).
+    class ThreadPool
+    {
+    public:
+        ThreadPool(uint32_t nThreads, size_t memoryBudget = SIZE_MAX);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        void operator=(const ThreadPool&) = delete;
+
+        void Submit(const std::function<void()>& task, size_t memory = 0);
+        void Wait();
+
+        inline uint32_t GetThreadCount() {return m_Workers.size();}
+
+    private:
+        void Work();
+
+    private:
+        struct Task
+        {
+            std::function<void()> Function;
+            size_t Memory;
+        };
+
+        std::vector<std::thread> m_Workers;
+        std::deque<Task> m_Tasks;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_StateChanged;
+
+        size_t m_MemoryBudget;
+        size_t m_MemoryInUse = 0;
+        uint32_t m_Running = 0;
+        bool m_Stop = false;
+    };
+}
+
+#endif // THREADPOOL_H
@@ -14,6 +14,9 @@ namespace DStream
 
         void Encode(uint16_t* values, uint8_t* dest, uint32_t count);
         void Decode(uint8_t* values, uint16_t* dest, uint32_t count);
+        // 4 byte RGBX pixels, see RgbxLayout.h
+        void EncodeRgbx(uint16_t* values, uint32_t* dest, uint32_t count);
+        void DecodeRgbx(uint32_t* values, uint16_t* dest, uint32_t count);
 
         Color ValueToColor(uint16_t val);
         uint16_t ColorToValue(const Color& col);
@@ -1,10 +1,16 @@
 #include <Writer.h>
 #include <jpeg_encoder.h>
+#include <SplitChannels.h>
 
 #include <QString>
 #include <QImage>
 #include <QFile>
 
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
 namespace DStream
 {
     Writer::Writer(const std::string& path) : m_OutputPath(path) {}
@@ -12,40 +18,116 @@ namespace DStream
     bool Writer::Write(uint8_t* data, uint32_t width, uint32_t height, OutputFormat format,
                        bool splitChannels/* = false*/, uint32_t quality/* = 100*/)
     {
-        uint8_t* encodedData = new uint8_t[width * height * 3];
-        ulong retSize;
+        if (format == OutputFormat::PNG)
+        {
+            PngEncoder encoder(m_Threads);
+            std::vector<uint8_t> png;
+
+            encoder.SetFilter(m_PngFilter);
+            encoder.SetCompressionLevel(m_PngLevel);
+            if (!encoder.Encode(data, width, height, m_Rgbx ? 4 : 3, png))
+                return false;
+            return WriteEncoded(png.data(), png.size());
+        }
+
+        if (splitChannels)
+        {
+            std::vector<uint32_t> qualities = m_ChannelQualities;
+            std::vector<std::vector<uint8_t>> jpegs;
+            std::string path = m_OutputPath;
+            size_t totalBytes = 0;
+
+            if (qualities.empty())
+                qualities.assign(3, quality);
+            if (!EncodeSplitChannels(data, width, height, m_Rgbx ? 4 : 3, qualities, m_Progressive, jpegs))
+                return false;
+
+            for (uint32_t c=0; c<jpegs.size(); c++)
+            {
+                m_OutputPath = SplitChannelPath(path, c);
+                bool written = WriteEncoded(jpegs[c].data(), jpegs[c].size());
+                totalBytes += m_WrittenBytes;
+                if (!written)
+                {
+                    m_OutputPath = path;
+                    return false;
+                }
+            }
+
+            m_OutputPath = path;
+            m_WrittenBytes = totalBytes;
+            return true;
+        }
+
+        // Let libjpeg allocate and grow the destination, retSize holds the compressed size once finished
+        uint8_t* encodedData = nullptr;
+        unsigned long retSize = 0;
         JpegEncoder encoder;
 
+        if (m_Rgbx)
+            encoder.setColorSpace(J_COLOR_SPACE::JCS_EXT_RGBX, 4);
         encoder.setJpegColorSpace(J_COLOR_SPACE::JCS_RGB);
         encoder.setQuality(quality);
+        encoder.setBaseTables(m_BaseTables);
+        encoder.setComponentScales(m_ComponentScales);
+        encoder.setProgressive(m_Progressive);
 
         encoder.init(width, height, &encodedData, &retSize);
         encoder.writeRows(data, height);
         encoder.finish();
 
+        bool ret = WriteEncoded(encodedData, retSize);
+        free(encodedData);
+        return ret;
+    }
+
+#ifdef DSTREAM_JPEG12
+    bool Writer::WriteJpeg12(const uint16_t* samples, uint32_t width, uint32_t height, uint32_t quality/* = 100*/)
+    {
+        Jpeg12Codec codec;
+        std::vector<uint8_t> jpeg;
+
+        codec.setQuality(quality);
+        codec.setProgressive(m_Progressive);
+        if (!codec.encode(samples, width, height, jpeg))
+            return false;
+        return WriteEncoded(jpeg.data(), jpeg.size());
+    }
+#endif
+
+    bool Writer::WriteEncoded(const uint8_t* data, size_t size)
+    {
         QFile out(QString(m_OutputPath.c_str()));
-        out.open(QIODevice::WriteOnly);
-        out.write((const char*)encodedData, retSize);
+        if (!out.open(QIODevice::WriteOnly))
+            return false;
+        out.write((const char*)data, size);
         out.close();
+        m_WrittenBytes = size;
 
         return true;
     }
 
-    bool Writer::Write(uint16_t* data, uint32_t width, uint32_t height)
+    bool Writer::Write(uint16_t* data, uint32_t width, uint32_t height, bool sixteenBit/* = true*/, int compressionLevel/* = -1*/)
     {
-        QImage out(width, height, QImage::Format_RGB888);
+        QImage out(width, height, sixteenBit ? QImage::Format_Grayscale16 : QImage::Format_Grayscale8);
 
+        // Scanlines may be padded, rows are filled one at a time
         for (uint32_t y=0; y<height; y++)
         {
-            for (uint32_t x=0; x<width; x++)
+            const uint16_t* src = data + y * width;
+            if (sixteenBit)
+                memcpy(out.scanLine(y), src, width * sizeof(uint16_t));
+            else
             {
-                float val = 255.0f * (data[x + y*width] / 65535.0f);
-                out.setPixel(x, y, qRgb(val, val, val));
+                uint8_t* dest = out.scanLine(y);
+                for (uint32_t x=0; x<width; x++)
+                    dest[x] = (uint32_t)src[x] * 255 / 65535;
             }
         }
 
-        out.save(QString(m_OutputPath.c_str()));
-        return true;
+        // Qt maps the PNG quality [0, 100] to the zlib level [9, 0] as (100 - quality) * 9 / 91
+        int quality = compressionLevel < 0 ? -1 : 100 - (std::min(compressionLevel, 9) * 91 + 8) / 9;
+        return out.save(QString(m_OutputPath.c_str()), "PNG", quality);
     }
         /*
 
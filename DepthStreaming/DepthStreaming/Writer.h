@@ -1,7 +1,15 @@
 #ifndef WRITER_H
 #define WRITER_H
 
+#include <PngEncoder.h>
+#ifdef DSTREAM_JPEG12
+#include <jpeg12.h>
+#endif
+
 #include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
 
 class QString;
 class QImage;
@@ -14,12 +22,44 @@ namespace DStream
     {
     public:
         Writer(const std::string& path);
+        // With splitChannels the JPEG channels are written as separate greyscale files, see SplitChannels.h
         bool Write(uint8_t* data, uint32_t width, uint32_t height, OutputFormat format, bool splitChannels = false, uint32_t quality = 100);
-        bool Write(uint16_t* data, uint32_t width, uint32_t height);
+        // Depth as a greyscale PNG, 16 bit keeps it lossless. compressionLevel is the zlib level (0-9), -1 for the default.
+        bool Write(uint16_t* data, uint32_t width, uint32_t height, bool sixteenBit = true, int compressionLevel = -1);
+        bool WriteEncoded(const uint8_t* data, size_t size);
+#ifdef DSTREAM_JPEG12
+        // Single component JPEG with 12 bit samples (0-4095), built with the Jpeg12 library
+        bool WriteJpeg12(const uint16_t* samples, uint32_t width, uint32_t height, uint32_t quality = 100);
+#endif
 
         inline void SetPath(const std::string& path) {m_OutputPath = path;}
+        inline void SetProgressive(bool progressive) {m_Progressive = progressive;}
+        // PNG output of encoded data
+        inline void SetPngFilter(PngFilter filter) {m_PngFilter = filter;}
+        inline void SetPngCompressionLevel(int level) {m_PngLevel = level;}
+        inline void SetThreads(uint32_t nThreads) {m_Threads = nThreads;}
+        // Encoded data given as 4 byte RGBX pixels instead of RGB
+        inline void SetRgbx(bool rgbx) {m_Rgbx = rgbx;}
+        // Quality of each channel written when splitting channels, the others are dropped. Empty keeps the 3 colour
+        // channels at the quality passed to Write.
+        inline void SetChannelQualities(const std::vector<uint32_t>& qualities) {m_ChannelQualities = qualities;}
+        // Quantization scale of each JPEG component, see JpegEncoder::setComponentScales
+        inline void SetComponentScales(const std::vector<float>& scales) {m_ComponentScales = scales;}
+        // Base quantization tables of the JPEG components, see JpegEncoder::setBaseTables
+        inline void SetBaseTables(const std::vector<std::vector<uint16_t>>& tables) {m_BaseTables = tables;}
+        // Size of the last encoded file written
+        inline size_t GetWrittenBytes() {return m_WrittenBytes;}
     private:
         std::string m_OutputPath;
+        bool m_Progressive = false;
+        PngFilter m_PngFilter = ADAPTIVE;
+        int m_PngLevel = 6;
+        uint32_t m_Threads = 0;
+        bool m_Rgbx = false;
+        std::vector<uint32_t> m_ChannelQualities;
+        std::vector<float> m_ComponentScales;
+        std::vector<std::vector<uint16_t>> m_BaseTables;
+        size_t m_WrittenBytes = 0;
     };
 }
 
@@ -23,6 +23,15 @@ J_COLOR_SPACE JpegDecoder::getColorSpace() const {
 	return colorSpace;
 }
 
+void JpegDecoder::setScale(int num, int denom) {
+	scaleNum = num;
+	scaleDenom = denom;
+}
+
+void JpegDecoder::setProfile(const JpegProfile& profile) {
+	this->profile = profile;
+}
+
 bool JpegDecoder::decode(uint8_t* buffer, size_t len, uint8_t*& img, int& width, int& height) {
 	if (buffer == nullptr)
 		return false;
@@ -48,10 +57,95 @@ bool JpegDecoder::decode(FILE *file, uint8_t*& img, int& width, int& height) {
 }
 
 
+bool JpegDecoder::decodePlanes(uint8_t* buffer, size_t len, std::vector<uint8_t>& planes, int& width, int& height, int& stride) {
+	if (buffer == nullptr)
+		return false;
+
+	jpeg_mem_src(&decInfo, buffer, len);
+	jpeg_read_header(&decInfo, (boolean)true);
+	arithmetic = decInfo.arith_code;
+	for(int c = 0; c < decInfo.num_components; c++) {
+		if(decInfo.comp_info[c].h_samp_factor != 1 || decInfo.comp_info[c].v_samp_factor != 1) {
+			jpeg_abort_decompress(&decInfo);
+			return false;
+		}
+	}
+	decInfo.raw_data_out = (boolean)true;
+	decInfo.do_fancy_upsampling = (boolean)false;
+	decInfo.dct_method = profile.dctMethod;
+	jpeg_start_decompress(&decInfo);
+
+	width = decInfo.output_width;
+	height = decInfo.output_height;
+	// Whole blocks are output, including the padding on the right and bottom edges
+	stride = decInfo.comp_info[0].width_in_blocks * DCTSIZE;
+	size_t planeSize = (size_t)stride * decInfo.comp_info[0].height_in_blocks * DCTSIZE;
+	planes.resize(planeSize * decInfo.num_components);
+
+	JSAMPROW rows[MAX_COMPONENTS][DCTSIZE];
+	JSAMPARRAY components[MAX_COMPONENTS];
+	for(int c = 0; c < decInfo.num_components; c++)
+		components[c] = rows[c];
+
+	while (decInfo.output_scanline < decInfo.output_height) {
+		for(int c = 0; c < decInfo.num_components; c++)
+			for(int y = 0; y < DCTSIZE; y++)
+				rows[c][y] = planes.data() + planeSize * c + (size_t)(decInfo.output_scanline + y) * stride;
+		jpeg_read_raw_data(&decInfo, components, DCTSIZE);
+	}
+
+	return jpeg_finish_decompress(&decInfo);
+}
+
+bool JpegDecoder::decodeScans(uint8_t* buffer, size_t len, int& width, int& height,
+							  const std::function<void(uint8_t* img, size_t bytesRead)>& onScan) {
+	if (buffer == nullptr)
+		return false;
+
+	jpeg_mem_src(&decInfo, buffer, len);
+	jpeg_read_header(&decInfo, (boolean)true);
+	arithmetic = decInfo.arith_code;
+	decInfo.out_color_space = colorSpace;
+	decInfo.jpeg_color_space = jpegColorSpace;
+	decInfo.scale_num = scaleNum;
+	decInfo.scale_denom = scaleDenom;
+	decInfo.dct_method = profile.dctMethod;
+	decInfo.do_fancy_upsampling = (boolean)profile.fancyUpsampling;
+	decInfo.do_block_smoothing = (boolean)profile.blockSmoothing;
+	decInfo.buffered_image = (boolean)true;
+
+	jpeg_start_decompress(&decInfo);
+	width = decInfo.output_width;
+	height = decInfo.output_height;
+
+	std::vector<uint8_t> img(decInfo.output_height * rowSize());
+	while (true) {
+		int ret;
+		do {
+			ret = jpeg_consume_input(&decInfo);
+		} while (ret != JPEG_SCAN_COMPLETED && ret != JPEG_REACHED_EOI && ret != JPEG_SUSPENDED);
+
+		if (ret != JPEG_SCAN_COMPLETED)
+			break;
+
+		size_t bytesRead = len - decInfo.src->bytes_in_buffer;
+		jpeg_start_output(&decInfo, decInfo.input_scan_number);
+		while (decInfo.output_scanline < decInfo.output_height) {
+			JSAMPROW row = img.data() + decInfo.output_scanline * rowSize();
+			jpeg_read_scanlines(&decInfo, &row, 1);
+		}
+		jpeg_finish_output(&decInfo);
+
+		onScan(img.data(), bytesRead);
+	}
+
+	return jpeg_finish_decompress(&decInfo);
+}
+
 bool JpegDecoder::decode(uint8_t*& img, int& width, int& height) {
 	init(width, height);
 
-	img = new uint8_t[decInfo.image_height * rowSize()];
+	img = new uint8_t[decInfo.output_height * rowSize()];
 
 	int readed = readRows(height, img);
 	if(readed != height)
@@ -77,36 +171,42 @@ bool JpegDecoder::init(const char* path, int &width, int &height) {
 
 bool JpegDecoder::init(int &width, int &height) {
 	jpeg_read_header(&decInfo, (boolean)true);
+	arithmetic = decInfo.arith_code;
 	decInfo.out_color_space = colorSpace;
 	decInfo.jpeg_color_space = jpegColorSpace;
 	decInfo.raw_data_out = (boolean)false;
+	decInfo.scale_num = scaleNum;
+	decInfo.scale_denom = scaleDenom;
+	decInfo.dct_method = profile.dctMethod;
+	decInfo.do_fancy_upsampling = (boolean)profile.fancyUpsampling;
+	decInfo.do_block_smoothing = (boolean)profile.blockSmoothing;
 	
 	if(decInfo.num_components > 1) 
 		subsampled =  decInfo.comp_info[1].h_samp_factor != 1;
 
 	jpeg_start_decompress(&decInfo);
 
-	width = decInfo.image_width;
-	height = decInfo.image_height;
+	width = decInfo.output_width;
+	height = decInfo.output_height;
 	return true;
 }
 
 size_t JpegDecoder::readRows(int nrows, uint8_t *buffer) { //return false on end.
-	if(decInfo.output_scanline == decInfo.image_height)
+	if(decInfo.output_scanline == decInfo.output_height)
 		restart();
 
-	size_t rowSize = decInfo.image_width * decInfo.num_components;
+	size_t rowSize = this->rowSize();
 	JSAMPROW rows[1];
 	size_t offset = 0;
 	int readed = 0;
-	while (decInfo.output_scanline < decInfo.image_height && readed < nrows) {
+	while (decInfo.output_scanline < decInfo.output_height && readed < nrows) {
 		readed++;
 		rows[0] = buffer + offset;
 		jpeg_read_scanlines(&decInfo, rows, 1);
 		offset += rowSize;
 	}
 
-	if(decInfo.output_scanline == decInfo.image_height)
+	if(decInfo.output_scanline == decInfo.output_height)
 		jpeg_finish_decompress(&decInfo);
 	return readed;
 }
@@ -4,9 +4,13 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cstdint>
+#include <functional>
+#include <vector>
 
 #include <jpeglib.h>
 
+#include "jpeg_profile.h"
+
 class JpegDecoder {
 public:
 	JpegDecoder();
@@ -20,20 +24,33 @@ public:
 	void setColorSpace(J_COLOR_SPACE space);
 	void setJpegColorSpace(J_COLOR_SPACE colorSpace);
 	J_COLOR_SPACE getColorSpace() const;
+	// Decode at num/denom of the original size using the scaled IDCT (1/1, 1/2, 1/4, 1/8)
+	void setScale(int num, int denom);
+	// Inverse DCT method, upsampling and block smoothing. decodePlanes only uses the DCT method, it never upsamples.
+	void setProfile(const JpegProfile& profile);
 	bool decode(uint8_t* buffer, size_t len, uint8_t*& img, int& width, int& height);
 	bool decode(const char* path, uint8_t*& img, int& width, int& height);
 	bool decode(FILE* file, uint8_t*& img, int& width, int& height);
+	// Raw data output: one plane per component in the JPEG color space, without color conversion or upsampling. The
+	// planes are stored one after the other, stride x (height rounded up to DCTSIZE) samples each. Only JPEGs without
+	// chroma subsampling are supported.
+	bool decodePlanes(uint8_t* buffer, size_t len, std::vector<uint8_t>& planes, int& width, int& height, int& stride);
+	// Buffered-image decode: onScan receives the image refined up to each completed scan and the bytes consumed so far
+	bool decodeScans(uint8_t* buffer, size_t len, int& width, int& height,
+					 const std::function<void(uint8_t* img, size_t bytesRead)>& onScan);
 
 	//file streaming reading support
 	bool init(const char* path, int &width, int &height);
 
-	size_t rowSize() { return decInfo.image_width * decInfo.num_components; }
+	size_t rowSize() { return decInfo.output_width * decInfo.output_components; }
 
 	//buffer must have rows*rowSize() space at least!
 	size_t readRows(int rows, uint8_t *buffer); //return false on end.
 	bool finish();
 	bool restart();
 	bool chromaSubsampled() { return subsampled; }
+	// Entropy coding of the last JPEG read, arithmetic decoding is done by libjpeg transparently
+	bool arithmeticCoded() { return arithmetic; }
 
 private:
 	FILE *file = nullptr;
@@ -47,6 +64,10 @@ private:
 	J_COLOR_SPACE jpegColorSpace = JCS_YCbCr;
 
 	bool subsampled = false;
+	bool arithmetic = false;
+	int scaleNum = 1;
+	int scaleDenom = 1;
+	JpegProfile profile;
 };
 
 #endif // JPEGDECODER_H_
@@ -1,8 +1,19 @@
 #include "jpeg_encoder.h"
 #include "jpeglib.h"
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
 using namespace std;
 
+// Float AAN forward DCT of libjpeg (jfdctflt.c, FAST_FLOAT is float), exported by libjpeg-turbo but declared in the private
+// jdct.h. Works in place on one block of centered samples, the output is scaled by 8 * aanscalefactor[row] *
+// aanscalefactor[col] like jcdctmgr expects.
+extern "C" void jpeg_fdct_float(float *data);
+
 JpegEncoder::JpegEncoder() {
 	info.err = jpeg_std_error(&errMgr);
 	jpeg_create_compress(&info);
@@ -37,14 +48,384 @@ int JpegEncoder::getQuality() const {
 	return quality;
 }
 
+void JpegEncoder::setComponentScales(const std::vector<float>& scales) {
+	componentScales = scales;
+}
+
+void JpegEncoder::setBaseTables(const std::vector<std::vector<uint16_t>>& tables) {
+	baseTables = tables;
+}
+
+bool JpegEncoder::loadPreset(const char* path, const char* name) {
+	std::vector<std::vector<uint16_t>> tables;
+	if(!loadPresetTables(path, name, tables))
+		return false;
+	baseTables = tables;
+	return true;
+}
+
+bool JpegEncoder::loadPresetTables(const char* path, const char* name, std::vector<std::vector<uint16_t>>& tables) {
+	std::ifstream in(path);
+	std::string line;
+
+	tables.clear();
+	while(std::getline(in, line)) {
+		std::istringstream ss(line);
+		std::string tableName;
+		size_t component;
+		if(!(ss >> tableName >> component) || tableName != name)
+			continue;
+
+		std::vector<uint16_t> table(DCTSIZE2);
+		for(int k = 0; k < DCTSIZE2; k++)
+			if(!(ss >> table[k]) || table[k] == 0)
+				return false;
+		if(tables.size() <= component)
+			tables.resize(component + 1);
+		tables[component] = table;
+	}
+
+	for(auto& table : tables)
+		if(table.empty())
+			return false;
+	return !tables.empty();
+}
+
+bool JpegEncoder::savePreset(const char* path, const char* name, const std::vector<std::vector<uint16_t>>& tables) {
+	// Other presets in the file are kept
+	std::vector<std::string> lines;
+	{
+		std::ifstream in(path);
+		std::string line;
+		while(std::getline(in, line)) {
+			std::istringstream ss(line);
+			std::string tableName;
+			if(!(ss >> tableName) || tableName != name)
+				lines.push_back(line);
+		}
+	}
+
+	std::ofstream out(path);
+	if(!out)
+		return false;
+	for(auto& line : lines)
+		out << line << "\n";
+	for(size_t c = 0; c < tables.size(); c++) {
+		out << name << " " << c;
+		for(uint16_t step : tables[c])
+			out << " " << step;
+		out << "\n";
+	}
+	return (bool)out;
+}
+
+// Quality tables, replaced by the base tables if any, then scaled per component. Every component with a custom table
+// gets its own slot, steps are kept in the baseline range.
+void JpegEncoder::setQuantization(jpeg_compress_struct &cinfo, int quality) const {
+	jpeg_set_quality(&cinfo, quality, (boolean)true);
+	int nComponents = std::min(cinfo.num_components, NUM_QUANT_TBLS);
+
+	if(!baseTables.empty()) {
+		int scale = jpeg_quality_scaling(quality);
+		for(int c = 0; c < nComponents; c++) {
+			const std::vector<uint16_t>& base = baseTables[std::min(c, (int)baseTables.size() - 1)];
+			unsigned int table[DCTSIZE2];
+			for(int k = 0; k < DCTSIZE2; k++)
+				table[k] = base[k];
+			jpeg_add_quant_table(&cinfo, c, table, scale, (boolean)true);
+			cinfo.comp_info[c].quant_tbl_no = c;
+		}
+	}
+
+	if(componentScales.empty())
+		return;
+
+	UINT16 base[NUM_QUANT_TBLS][DCTSIZE2];
+	for(int c = 0; c < nComponents; c++)
+		memcpy(base[c], cinfo.quant_tbl_ptrs[cinfo.comp_info[c].quant_tbl_no]->quantval, sizeof(base[c]));
+
+	for(int c = 0; c < nComponents; c++) {
+		float scale = c < (int)componentScales.size() ? componentScales[c] : 1.0f;
+		if(cinfo.quant_tbl_ptrs[c] == nullptr)
+			cinfo.quant_tbl_ptrs[c] = jpeg_alloc_quant_table((j_common_ptr)&cinfo);
+
+		JQUANT_TBL *table = cinfo.quant_tbl_ptrs[c];
+		for(int k = 0; k < DCTSIZE2; k++)
+			table->quantval[k] = (UINT16)std::min(255L, std::max(1L, std::lround(base[c][k] * scale)));
+		table->sent_table = (boolean)false;
+		cinfo.comp_info[c].quant_tbl_no = c;
+	}
+}
+
 void JpegEncoder::setOptimize(bool optimize) {
 	this->optimize = optimize;
 }
 
+void JpegEncoder::setArithmetic(bool arithmetic) {
+	this->arithmetic = arithmetic;
+}
+
+void JpegEncoder::setHuffmanTables(const HuffmanTables& tables) {
+	huffmanTables = tables;
+}
+
+void JpegEncoder::setProfile(const JpegProfile& profile) {
+	dctMethod = profile.dctMethod;
+}
+
+// Arithmetic coding adapts to the data as it goes, there are no Huffman tables to optimize or replace
+void JpegEncoder::setEntropyCoding(jpeg_compress_struct &cinfo) const {
+	cinfo.arith_code = (boolean)arithmetic;
+	cinfo.optimize_coding = (boolean)(optimize && !arithmetic && huffmanTables.empty());
+	if(arithmetic || huffmanTables.empty())
+		return;
+
+	for(int slot = 0; slot < 2; slot++) {
+		const HuffmanSpec *specs[2] = {&huffmanTables.dc[slot], &huffmanTables.ac[slot]};
+		JHUFF_TBL **tables[2] = {&cinfo.dc_huff_tbl_ptrs[slot], &cinfo.ac_huff_tbl_ptrs[slot]};
+		for(int t = 0; t < 2; t++) {
+			if(specs[t]->values.empty())
+				continue;
+			if(*tables[t] == nullptr)
+				*tables[t] = jpeg_alloc_huff_table((j_common_ptr)&cinfo);
+			memcpy((*tables[t])->bits, specs[t]->bits, sizeof(specs[t]->bits));
+			memcpy((*tables[t])->huffval, specs[t]->values.data(), specs[t]->values.size());
+			(*tables[t])->sent_table = (boolean)false;
+		}
+	}
+}
+
+static HuffmanSpec toSpec(const JHUFF_TBL *table) {
+	HuffmanSpec spec;
+	if(table == nullptr)
+		return spec;
+
+	int count = 0;
+	for(int n = 1; n <= 16; n++) {
+		spec.bits[n] = table->bits[n];
+		count += table->bits[n];
+	}
+	spec.values.assign(table->huffval, table->huffval + count);
+	return spec;
+}
+
+HuffmanTables JpegEncoder::getHuffmanTables() const {
+	HuffmanTables tables;
+	for(int slot = 0; slot < 2; slot++) {
+		tables.dc[slot] = toSpec(info.dc_huff_tbl_ptrs[slot]);
+		tables.ac[slot] = toSpec(info.ac_huff_tbl_ptrs[slot]);
+	}
+	return tables;
+}
+
+// Length limited Huffman code of the given frequencies, the procedure of jpeg_gen_optimal_table (JPEG Annex K.2).
+// Symbol 256 is reserved so that no code is all ones.
+static HuffmanSpec buildHuffmanSpec(std::vector<long long> freq) {
+	const int maxLength = 32;
+	int bits[maxLength + 1] = {};
+	int codeSize[257] = {};
+	int others[257];
+
+	std::fill(others, others + 257, -1);
+	freq.resize(257);
+	freq[256] = 1;
+
+	while(true) {
+		// The two least frequent symbols, c1 taking the largest index on ties
+		int c1 = -1, c2 = -1;
+		for(int i = 0; i <= 256; i++)
+			if(freq[i] && (c1 < 0 || freq[i] <= freq[c1]))
+				c1 = i;
+		for(int i = 0; i <= 256; i++)
+			if(freq[i] && i != c1 && (c2 < 0 || freq[i] <= freq[c2]))
+				c2 = i;
+		if(c2 < 0)
+			break;
+
+		freq[c1] += freq[c2];
+		freq[c2] = 0;
+		codeSize[c1]++;
+		while(others[c1] >= 0) {
+			c1 = others[c1];
+			codeSize[c1]++;
+		}
+		others[c1] = c2;
+		codeSize[c2]++;
+		while(others[c2] >= 0) {
+			c2 = others[c2];
+			codeSize[c2]++;
+		}
+	}
+
+	for(int i = 0; i <= 256; i++)
+		if(codeSize[i])
+			bits[std::min(codeSize[i], maxLength)]++;
+
+	// Codes longer than 16 bits are moved up the tree
+	for(int i = maxLength; i > 16; i--) {
+		while(bits[i] > 0) {
+			int j = i - 2;
+			while(bits[j] == 0)
+				j--;
+			bits[i] -= 2;
+			bits[i - 1]++;
+			bits[j + 1] += 2;
+			bits[j]--;
+		}
+	}
+	int longest = 16;
+	while(bits[longest] == 0)
+		longest--;
+	bits[longest]--;
+
+	HuffmanSpec spec;
+	for(int n = 1; n <= 16; n++)
+		spec.bits[n] = bits[n];
+	for(int n = 1; n <= maxLength; n++)
+		for(int s = 0; s < 256; s++)
+			if(codeSize[s] == n)
+				spec.values.push_back(s);
+	return spec;
+}
+
+// Probability of every symbol implied by the code lengths of a table
+static void addProbabilities(const HuffmanSpec &spec, std::vector<double> &probabilities) {
+	size_t k = 0;
+	for(int n = 1; n <= 16; n++)
+		for(int i = 0; i < spec.bits[n] && k < spec.values.size(); i++)
+			probabilities[spec.values[k++]] += std::ldexp(1.0, -n);
+}
+
+HuffmanTables JpegEncoder::mergeHuffmanTables(const std::vector<HuffmanTables>& sets) {
+	HuffmanTables merged;
+	for(int slot = 0; slot < 2; slot++) {
+		for(int t = 0; t < 2; t++) {
+			bool dc = t == 0;
+			std::vector<double> probabilities(256, 0.0);
+			for(auto& set : sets)
+				addProbabilities(dc ? set.dc[slot] : set.ac[slot], probabilities);
+
+			// Every baseline symbol keeps a code, an image unlike the training ones can still be encoded
+			std::vector<long long> freq(256, 0);
+			for(int s = 0; s < 256; s++) {
+				int size = s & 15;
+				bool valid = dc ? s <= 11 : (s == 0x00 || s == 0xF0 || (size >= 1 && size <= 10));
+				if(valid)
+					freq[s] = 1 + std::llround(probabilities[s] / std::max<size_t>(sets.size(), 1) * (1 << 24));
+			}
+			(dc ? merged.dc[slot] : merged.ac[slot]) = buildHuffmanSpec(freq);
+		}
+	}
+	return merged;
+}
+
+// Counts and symbols of one preset line, after its name, kind and slot
+static bool readHuffmanSpec(std::istringstream& ss, HuffmanSpec& spec) {
+	int value, count = 0;
+
+	for(int n = 1; n <= 16; n++) {
+		if(!(ss >> value) || value < 0 || value > 255)
+			return false;
+		spec.bits[n] = value;
+		count += value;
+	}
+	spec.values.clear();
+	while(ss >> value) {
+		if(value < 0 || value > 255)
+			return false;
+		spec.values.push_back(value);
+	}
+	return ss.eof() && (int)spec.values.size() == count && count <= 256;
+}
+
+bool JpegEncoder::loadHuffmanPreset(const char* path, const char* name, HuffmanTables& tables) {
+	std::ifstream in(path);
+	std::string line;
+	bool found = false;
+
+	tables = HuffmanTables();
+	while(std::getline(in, line)) {
+		std::istringstream ss(line);
+		std::string tableName, kind;
+		int slot;
+		if(!(ss >> tableName >> kind >> slot) || tableName != name || (kind != "dc" && kind != "ac") || slot < 0 || slot > 1)
+			continue;
+
+		if(!readHuffmanSpec(ss, kind == "dc" ? tables.dc[slot] : tables.ac[slot]))
+			return false;
+		found = true;
+	}
+	return found && !tables.empty();
+}
+
+bool JpegEncoder::loadHuffmanPresets(const char* path, std::map<std::string, HuffmanTables>& presets) {
+	std::ifstream in(path);
+	std::string line;
+
+	if(!in)
+		return false;
+	presets.clear();
+	while(std::getline(in, line)) {
+		std::istringstream ss(line);
+		std::string tableName, kind;
+		int slot;
+		if(!(ss >> tableName))
+			continue;
+		if(!(ss >> kind >> slot) || (kind != "dc" && kind != "ac") || slot < 0 || slot > 1)
+			return false;
+
+		HuffmanTables &tables = presets[tableName];
+		if(!readHuffmanSpec(ss, kind == "dc" ? tables.dc[slot] : tables.ac[slot]))
+			return false;
+	}
+	for(auto& preset : presets)
+		if(preset.second.empty())
+			return false;
+	return true;
+}
+
+bool JpegEncoder::saveHuffmanPreset(const char* path, const char* name, const HuffmanTables& tables) {
+	std::vector<std::string> lines;
+	{
+		std::ifstream in(path);
+		std::string line;
+		while(std::getline(in, line)) {
+			std::istringstream ss(line);
+			std::string tableName;
+			if(!(ss >> tableName) || tableName != name)
+				lines.push_back(line);
+		}
+	}
+
+	std::ofstream out(path);
+	if(!out)
+		return false;
+	for(auto& line : lines)
+		out << line << "\n";
+	for(int slot = 0; slot < 2; slot++) {
+		for(int t = 0; t < 2; t++) {
+			const HuffmanSpec &spec = t == 0 ? tables.dc[slot] : tables.ac[slot];
+			if(spec.values.empty())
+				continue;
+			out << name << (t == 0 ? " dc " : " ac ") << slot;
+			for(int n = 1; n <= 16; n++)
+				out << " " << (int)spec.bits[n];
+			for(uint8_t value : spec.values)
+				out << " " << (int)value;
+			out << "\n";
+		}
+	}
+	return (bool)out;
+}
+
 void JpegEncoder::setChromaSubsampling(bool subsample) {
 	this->subsample = subsample;
 }
 
+void JpegEncoder::setProgressive(bool progressive) {
+	this->progressive = progressive;
+}
+
 
 
 bool JpegEncoder::encode(uint8_t* img, int width, int height, FILE* file) {
@@ -74,6 +455,196 @@ bool JpegEncoder::encode(uint8_t* img, int width, int height, uint8_t *&buffer,
 	return true;
 }
 
+bool JpegEncoder::encodeQualities(uint8_t* img, int width, int height, const std::vector<int>& qualities,
+								  std::vector<std::vector<uint8_t>>& buffers) {
+	buffers.resize(qualities.size());
+
+	int outComponents = jpegColorSpace == JCS_GRAYSCALE ? 1 : 3;
+	bool rgbInput = (colorSpace == JCS_RGB && numComponents == 3) || (colorSpace == JCS_EXT_RGBX && numComponents == 4);
+	bool sharedPass = !(jpegColorSpace == JCS_YCbCr && subsample) &&
+			((jpegColorSpace == JCS_GRAYSCALE && numComponents == 1) ||
+			 ((jpegColorSpace == JCS_RGB || jpegColorSpace == JCS_YCbCr) && rgbInput));
+
+	// Subsampled or exotic layouts go through the regular pipeline once per quality
+	if(!sharedPass) {
+		int userQuality = quality;
+		for(size_t q = 0; q < qualities.size(); q++) {
+			uint8_t *mem = nullptr;
+			int length = 0;
+			quality = qualities[q];
+			bool ok = encode(img, width, height, mem, length);
+			if(ok) buffers[q].assign(mem, mem + length);
+			free(mem);
+			if(!ok) {
+				quality = userQuality;
+				return false;
+			}
+		}
+		quality = userQuality;
+		return true;
+	}
+
+	// Color conversion and libjpeg's float forward DCT, kept unquantized so that every quality is rounded only once
+	int blocksX = (width + DCTSIZE - 1) / DCTSIZE;
+	int blocksY = (height + DCTSIZE - 1) / DCTSIZE;
+	std::vector<std::vector<float>> coefs(outComponents, std::vector<float>((size_t)blocksX * blocksY * DCTSIZE2));
+
+	// Removes the AAN scaling, as the float divisors of jcdctmgr do
+	static const double aanScaleFactor[DCTSIZE] = {
+		1.0, 1.387039845, 1.306562965, 1.175875602, 1.0, 0.785694958, 0.541196100, 0.275899379
+	};
+	float descale[DCTSIZE2];
+	for(int v = 0; v < DCTSIZE; v++)
+		for(int u = 0; u < DCTSIZE; u++)
+			descale[v * DCTSIZE + u] = (float)(1.0 / (aanScaleFactor[v] * aanScaleFactor[u] * 8.0));
+
+	for(int by = 0; by < blocksY; by++) {
+		for(int bx = 0; bx < blocksX; bx++) {
+			float samples[3][DCTSIZE2];
+			for(int y = 0; y < DCTSIZE; y++) {
+				// Edge blocks replicate the last row / column like libjpeg does
+				int sy = std::min(by * DCTSIZE + y, height - 1);
+				for(int x = 0; x < DCTSIZE; x++) {
+					int sx = std::min(bx * DCTSIZE + x, width - 1);
+					const uint8_t *px = img + ((size_t)sy * width + sx) * numComponents;
+					if(jpegColorSpace == JCS_YCbCr) {
+						samples[0][y * DCTSIZE + x] = 0.299f * px[0] + 0.587f * px[1] + 0.114f * px[2] - CENTERJSAMPLE;
+						samples[1][y * DCTSIZE + x] = -0.168736f * px[0] - 0.331264f * px[1] + 0.5f * px[2];
+						samples[2][y * DCTSIZE + x] = 0.5f * px[0] - 0.418688f * px[1] - 0.081312f * px[2];
+					} else {
+						for(int c = 0; c < outComponents; c++)
+							samples[c][y * DCTSIZE + x] = (float)px[c] - CENTERJSAMPLE;
+					}
+				}
+			}
+
+			for(int c = 0; c < outComponents; c++) {
+				float *out = coefs[c].data() + ((size_t)by * blocksX + bx) * DCTSIZE2;
+				jpeg_fdct_float(samples[c]);
+				for(int k = 0; k < DCTSIZE2; k++)
+					out[k] = samples[c][k] * descale[k];
+			}
+		}
+	}
+
+	// Quantize and entropy code the shared coefficients once per quality
+	for(size_t q = 0; q < qualities.size(); q++) {
+		jpeg_compress_struct dst;
+		jpeg_error_mgr dstErr;
+		unsigned char *mem = nullptr;
+		unsigned long memSize = 0;
+
+		dst.err = jpeg_std_error(&dstErr);
+		jpeg_create_compress(&dst);
+		jpeg_mem_dest(&dst, &mem, &memSize);
+
+		dst.image_width = width;
+		dst.image_height = height;
+		dst.in_color_space = colorSpace;
+		dst.input_components = numComponents;
+		jpeg_set_defaults(&dst);
+		jpeg_set_colorspace(&dst, jpegColorSpace);
+		setQuantization(dst, qualities[q]);
+		setEntropyCoding(dst);
+		for(int c = 0; c < dst.num_components; c++) {
+			dst.comp_info[c].h_samp_factor = 1;
+			dst.comp_info[c].v_samp_factor = 1;
+		}
+		if(progressive)
+			jpeg_simple_progression(&dst);
+
+		std::vector<jvirt_barray_ptr> coefArrays(outComponents);
+		for(int c = 0; c < outComponents; c++)
+			coefArrays[c] = (*dst.mem->request_virt_barray)((j_common_ptr)&dst, JPOOL_IMAGE, (boolean)true, blocksX, blocksY, 1);
+		(*dst.mem->realize_virt_arrays)((j_common_ptr)&dst);
+
+		for(int c = 0; c < outComponents; c++) {
+			const UINT16 *step = dst.quant_tbl_ptrs[dst.comp_info[c].quant_tbl_no]->quantval;
+			float divisors[DCTSIZE2];
+			for(int k = 0; k < DCTSIZE2; k++)
+				divisors[k] = 1.0f / step[k];
+			for(int by = 0; by < blocksY; by++) {
+				JBLOCKARRAY row = (*dst.mem->access_virt_barray)((j_common_ptr)&dst, coefArrays[c], by, 1, (boolean)true);
+				const float *in = coefs[c].data() + (size_t)by * blocksX * DCTSIZE2;
+				// Rounds like jcdctmgr's float quantization, the offset keeps the int conversion away from negatives
+				for(int bx = 0; bx < blocksX; bx++)
+					for(int k = 0; k < DCTSIZE2; k++)
+						row[0][bx][k] = (JCOEF)((int)(in[bx * DCTSIZE2 + k] * divisors[k] + 16384.5f) - 16384);
+			}
+		}
+
+		jpeg_write_coefficients(&dst, coefArrays.data());
+		jpeg_finish_compress(&dst);
+		buffers[q].assign(mem, mem + memSize);
+		jpeg_destroy_compress(&dst);
+		free(mem);
+	}
+
+	return true;
+}
+
+int JpegEncoder::paddedSize(int size) {
+	return (size + DCTSIZE - 1) / DCTSIZE * DCTSIZE;
+}
+
+bool JpegEncoder::encodePlanes(uint8_t **planes, int width, int height, uint8_t *&buffer, int &length) {
+	int stride = paddedSize(width);
+	int paddedHeight = paddedSize(height);
+
+	// Raw data bypasses the edge expansion of the preprocessor, blocks crossing the border are completed by replication
+	for(int c = 0; c < numComponents; c++) {
+		uint8_t *plane = planes[c];
+		if(stride > width)
+			for(int y = 0; y < height; y++)
+				memset(plane + (size_t)y * stride + width, plane[(size_t)y * stride + width - 1], stride - width);
+		for(int y = height; y < paddedHeight; y++)
+			memcpy(plane + (size_t)y * stride, plane + (size_t)(height - 1) * stride, stride);
+	}
+
+	unsigned char *mem = nullptr;
+	unsigned long memSize = 0;
+	jpeg_mem_dest(&info, &mem, &memSize);
+
+	info.image_width = width;
+	info.image_height = height;
+	info.in_color_space = jpegColorSpace;
+	info.input_components = numComponents;
+
+	jpeg_set_defaults(&info);
+	jpeg_set_colorspace(&info, jpegColorSpace);
+	setQuantization(info, quality);
+	setEntropyCoding(info);
+	info.dct_method = dctMethod;
+	info.raw_data_in = (boolean)true;
+	for(int i = 0; i < info.num_components; i++) {
+		info.comp_info[i].h_samp_factor = 1;
+		info.comp_info[i].v_samp_factor = 1;
+	}
+
+	if(progressive)
+		jpeg_simple_progression(&info);
+
+	jpeg_start_compress(&info, (boolean)true);
+
+	// One iMCU row (DCTSIZE rows of every component) per call
+	JSAMPROW rows[MAX_COMPONENTS][DCTSIZE];
+	JSAMPARRAY components[MAX_COMPONENTS];
+	for(int c = 0; c < info.num_components; c++)
+		components[c] = rows[c];
+
+	while (info.next_scanline < info.image_height) {
+		for(int c = 0; c < info.num_components; c++)
+			for(int y = 0; y < DCTSIZE; y++)
+				rows[c][y] = planes[c] + (size_t)(info.next_scanline + y) * stride;
+		jpeg_write_raw_data(&info, components, DCTSIZE);
+	}
+
+	jpeg_finish_compress(&info);
+	length = memSize;
+	buffer = mem;
+	return true;
+}
+
 bool JpegEncoder::encode(uint8_t* img, int width, int height) {
 	info.image_width = width;
 	info.image_height = height;
@@ -82,8 +653,9 @@ bool JpegEncoder::encode(uint8_t* img, int width, int height) {
 
     jpeg_set_defaults(&info);
 	jpeg_set_colorspace(&info, jpegColorSpace);
-	jpeg_set_quality(&info, quality, (boolean)true);
-	info.optimize_coding = (boolean)optimize;
+	setQuantization(info, quality);
+	setEntropyCoding(info);
+	info.dct_method = dctMethod;
 
 	if(jpegColorSpace == JCS_YCbCr && subsample == false) {
 		for(int i = 0; i < numComponents; i++) {
@@ -92,6 +664,9 @@ bool JpegEncoder::encode(uint8_t* img, int width, int height) {
 		}
 	}
 
+	if(progressive)
+		jpeg_simple_progression(&info);
+
 	jpeg_start_compress(&info, (boolean)true);
 
 	writeRows(img, height);
@@ -125,8 +700,9 @@ bool JpegEncoder::init(int width, int height) {
 
 	jpeg_set_defaults(&info);
 	jpeg_set_colorspace(&info, jpegColorSpace);
-	jpeg_set_quality(&info, quality, (boolean)true);
-	info.optimize_coding = (boolean)optimize;
+	setQuantization(info, quality);
+	setEntropyCoding(info);
+	info.dct_method = dctMethod;
 
 	if(jpegColorSpace == JCS_YCbCr && subsample == false)
 		for(int i = 0; i < numComponents; i++) {
@@ -134,6 +710,9 @@ bool JpegEncoder::init(int width, int height) {
 			info.comp_info[i].v_samp_factor = 1;
 		}
 
+	if(progressive)
+		jpeg_simple_progression(&info);
+
     jpeg_start_compress(&info, TRUE);
 	return true;
 }
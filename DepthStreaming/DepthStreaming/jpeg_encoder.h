@@ -4,9 +4,27 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
 
 #include <jpeglib.h>
 
+#include "jpeg_profile.h"
+
+// Huffman table in DHT form: bits[n] codes of n bits (1-16), then the symbols in order of increasing code length
+struct HuffmanSpec {
+	uint8_t bits[17] = {};
+	std::vector<uint8_t> values;
+};
+
+// DC and AC tables of the two baseline slots: 0 codes the luma or every RGB component, 1 the chroma
+struct HuffmanTables {
+	HuffmanSpec dc[2], ac[2];
+
+	bool empty() const { return dc[0].values.empty(); }
+};
+
 class JpegEncoder {
 public:
 	JpegEncoder();
@@ -22,12 +40,51 @@ public:
 	int getNumComponents() const;
 	void setQuality(int quality);
 	int getQuality() const;
+	// Quantization steps of JPEG component c multiplied by scales[c] on top of the quality tables, so the bits can be
+	// spent where the channel matters most. Components past the end keep a scale of 1, empty disables the scaling.
+	void setComponentScales(const std::vector<float>& scales);
+	// Base quantization table of each component (64 steps in natural order) used instead of the IJG ones and scaled by
+	// the quality the same way, quality 50 uses them as they are. Components past the end use the last table, empty
+	// restores the IJG tables.
+	void setBaseTables(const std::vector<std::vector<uint16_t>>& tables);
+	// Named base table presets, stored as text with one "name component step0 ... step63" line per table. Saving
+	// replaces the tables already stored under the same name.
+	bool loadPreset(const char* path, const char* name);
+	static bool loadPresetTables(const char* path, const char* name, std::vector<std::vector<uint16_t>>& tables);
+	static bool savePreset(const char* path, const char* name, const std::vector<std::vector<uint16_t>>& tables);
 	void setOptimize(bool optimize);
+	// Arithmetic instead of Huffman entropy coding, smaller but slower and not supported by every decoder
+	void setArithmetic(bool arithmetic);
+	// Single pass encoding with fixed Huffman tables, e.g. pretrained for the coder and quality, instead of the
+	// optimization pass. Empty tables go back to setOptimize. Progressive JPEGs are always optimized by libjpeg.
+	void setHuffmanTables(const HuffmanTables& tables);
+	// Tables used by the last encode, the optimal ones if it ran the optimization pass
+	HuffmanTables getHuffmanTables() const;
+	// Tables coding every baseline symbol, from the symbol probabilities implied by the code lengths of each set
+	static HuffmanTables mergeHuffmanTables(const std::vector<HuffmanTables>& sets);
+	// Named Huffman presets, one "name dc|ac slot bits1 ... bits16 symbols..." line per table, saving replaces the
+	// tables already stored under the same name. Loading fails on counts or symbols outside a byte, and
+	// loadHuffmanPresets on any malformed line of the file.
+	static bool loadHuffmanPreset(const char* path, const char* name, HuffmanTables& tables);
+	static bool loadHuffmanPresets(const char* path, std::map<std::string, HuffmanTables>& presets);
+	static bool saveHuffmanPreset(const char* path, const char* name, const HuffmanTables& tables);
+	// DCT method of the profile, encodeQualities runs its own forward DCT and ignores it
+	void setProfile(const JpegProfile& profile);
 	void setChromaSubsampling(bool subsample);
+	// Emit a progressive JPEG using the default jpeg_simple_progression script
+	void setProgressive(bool progressive);
 
 	bool encode(uint8_t *img, int width, int height, FILE* file);
 	bool encode(uint8_t *img, int width, int height, const char* path);
 	bool encode(uint8_t *img, int width, int height, uint8_t *&buffer, int &length);
+	// Color conversion and forward DCT run once, then the coefficients are quantized and entropy coded for each quality.
+	// Entropy coding dominates with libjpeg-turbo, so the sweep runs about as fast as one encode per quality.
+	bool encodeQualities(uint8_t *img, int width, int height, const std::vector<int>& qualities,
+						 std::vector<std::vector<uint8_t>>& buffers);
+	// Raw data input: one plane per component, already in the JPEG color space and not subsampled, so color conversion
+	// and downsampling are skipped. Planes are paddedSize(width) x paddedSize(height), the padding is filled here.
+	bool encodePlanes(uint8_t **planes, int width, int height, uint8_t *&buffer, int &length);
+	static int paddedSize(int size);
 
     bool init(int width, int height, uint8_t** buffer, unsigned long* size);
 	bool writeRows(uint8_t *rows, int n);
@@ -36,6 +93,8 @@ public:
 private:
 	bool init(int width, int height);
 	bool encode(uint8_t* img, int width, int height);
+	void setQuantization(jpeg_compress_struct &cinfo, int quality) const;
+	void setEntropyCoding(jpeg_compress_struct &cinfo) const;
 	static void onError(j_common_ptr cinfo);
 	static void onMessage(j_common_ptr cinfo);
 
@@ -47,9 +106,15 @@ private:
 	J_COLOR_SPACE jpegColorSpace = JCS_YCbCr;
 	int numComponents = 3;
 	bool optimize = true;
+	bool arithmetic = false;
+	HuffmanTables huffmanTables;
 	bool subsample = false;
+	bool progressive = false;
+	J_DCT_METHOD dctMethod = JDCT_ISLOW;
 
 	int quality = 90;
+	std::vector<float> componentScales;
+	std::vector<std::vector<uint16_t>> baseTables;
 };
 
 #endif // JPEGENCODER_H_
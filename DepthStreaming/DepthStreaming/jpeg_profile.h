@@ -0,0 +1,35 @@
+#ifndef JPEGPROFILE_H_
+#define JPEGPROFILE_H_
+
+#include <cstdio>
+#include <cstring>
+
+#include <jpeglib.h>
+
+// Speed/accuracy settings of libjpeg shared by JpegEncoder and JpegDecoder. The encoder only uses the DCT method,
+// upsampling and block smoothing are decoder settings (smoothing only affects progressive JPEGs).
+struct JpegProfile {
+	const char *name = "default";
+	J_DCT_METHOD dctMethod = JDCT_ISLOW;
+	bool fancyUpsampling = true;
+	bool blockSmoothing = true;
+
+	// fast: scaled integer DCT, no fancy upsampling or block smoothing. default: the libjpeg defaults, accurate integer
+	// DCT. accurate: floating point DCT. Returns false for an unknown name.
+	static bool byName(const char *name, JpegProfile &profile) {
+		static const JpegProfile profiles[] = {
+			{"fast", JDCT_IFAST, false, false},
+			{"default", JDCT_ISLOW, true, true},
+			{"accurate", JDCT_FLOAT, true, true}
+		};
+		for(const JpegProfile &p : profiles) {
+			if(strcmp(p.name, name) == 0) {
+				profile = p;
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+#endif // JPEGPROFILE_H_
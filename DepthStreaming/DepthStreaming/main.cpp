@@ -7,31 +7,34 @@
 #include <PhaseCoder.h>
 #include <TriangleCoder.h>
 #include <PackedCoder.h>
+#include <CoderDispatch.h>
+#include <jpeg_decoder.h>
+#include <jpeg_encoder.h>
+#include <ThreadPool.h>
+#include <Profiler.h>
+#include <ErrorAnalysis.h>
+#include <RateDistortion.h>
+#include <MedianFilter.h>
+#include <PngEncoder.h>
+#include <ComponentPlanes.h>
+#include <RgbxLayout.h>
+#include <SplitChannels.h>
+#include <GetOpt.h>
+#ifdef DSTREAM_JPEG12
+#include <jpeg12.h>
+#endif
 
 #include <QImage>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <filesystem>
-
-#ifndef _WIN32
-#include <unistd.h>
-#else
-#include <stdio.h>
-#include <string.h>
-int opterr = 1, optind = 1, optopt, optreset;
-const char* optarg;
-int getopt(int nargc, char* const nargv[], const char* ostr);
-#endif
+#include <sstream>
 
 using namespace DStream;
 using namespace std;
 
-/** TODO LIST:
- *  - Support PNG
- */
-
-
 void Usage()
 {
     cerr <<
@@ -39,20 +42,120 @@ void Usage()
 
     FILE is the path to the ASC file containing the depth data
       -d <output>: output folder in which data will be saved
-      -a <algorithm>: algorithm to be tested (algorithm names: PACKED,TRIANGLE,MORTON,HILBERT,PHASE,SPLIT), if not specified, all of them will be tested
+      -a <algorithm>: algorithm to be tested (algorithm names: PACKED,TRIANGLE,MORTON,HILBERT,PHASE,SPLIT,JPEG12), if not specified, all of them will be tested.
+         JPEG12 stores the top 12 bits of the depth in a 12 bit greyscale JPEG and is only available when built with CONFIG+=jpeg12
       -q <quality>: JPEG quality to be used (if not specified, values 80,85,90,95,100 will be tested)
-      -f <format>: output format (JPEG or PNG), defaults to JPEG
+      -f <format>: output format (JPEG or PNG), defaults to JPEG. PNG also stores the encoded data losslessly and compares the row filters
+      -i: keep the JPEG round trip in memory instead of writing and reloading files
+      -n: don't write decoded images, error images and histograms, only the CSV metrics
+      -m: run the forward DCT once per algorithm and requantize it for every tested quality
+      -p: write progressive JPEGs and measure the depth error after each scan against the bytes received
+      -s <scale>: also decode a 1/scale preview (2, 4 or 8) straight from the DCT and measure its error
+      -g: run the whole algorithm x quality x quantization x curve bits grid in parallel (in memory, CSV metrics only,
+          takes precedence over -e and -r)
+      -t <threads>: number of worker threads for -g, defaults to the number of cores
+      -b <megabytes>: memory budget for the tasks running concurrently in -g, unlimited by default
+      -Q <list>: comma separated coder quantizations swept by -g (default 10,12,14,16)
+      -c <list>: comma separated curve bits swept by -g for HILBERT and MORTON (default 3,4,5,6), configurations a coder
+         can't invert exactly are skipped
+      -e <error>: rate control, search the lowest JPEG quality whose max depth error is at most <error>
+      -r <rmse>: rate control, search the lowest JPEG quality whose depth RMSE is at most <rmse>
+      -T <size>: run the rate control search independently on tiles of <size>x<size> pixels (multiple of 8)
+      -u <step>: while searching, encode only one 8x8 block every <step> in both directions (default 4)
+      -F <window>: median filter the decoded depth with a 3x3 or 5x5 window before measuring the error
+      -o <threshold>: with -F, only replace pixels further than <threshold> from the median (outlier rejection)
+      -z <level>: zlib compression level (0-9) of the PNGs written
+      -8: write the decoded depth as 8 bit PNGs instead of lossless 16 bit ones
+      -y <basis>: coders write straight into the JPEG component planes, compressed as raw data without colour conversion.
+         basis is RGB (the coder channels as JPEG components) or YCbCr (converted by the coder)
+      -x: coders write and read 4 byte RGBX pixels (one aligned 32 bit word each) instead of packed 3 byte RGB
+      -S <offsets>: store each channel a coder uses as its own greyscale JPEG (PACKED, SPLIT and PHASE drop the empty blue one).
+         offsets is a comma separated list added to the tested quality for each channel, e.g. 0,-20 (0 if missing)
+      -k[scales]: scale the quantization steps of each JPEG component, by the per-coder preset or, if given, by the comma
+         separated scales for every coder (e.g. -k0.5,2,1). Applies to the serial benchmark, -g and the rate control
+      -A: also encode and decode every tested quality with arithmetic coding, bytes and times against Huffman in Entropy.csv
+      -H <file>: also encode every tested quality in a single pass with the Huffman tables pretrained for the coder and
+         quality (presets <ALGORITHM>_q<quality> in file, see QuantTableOptimizer -H), bytes and times against the
+         optimized and the standard tables in Huffman.csv
+      -D <profiles>: also encode and decode every tested quality with each comma separated libjpeg profile (fast, default,
+         accurate: DCT method, fancy upsampling and block smoothing), bytes, times and depth error in Profiles.csv
+      -P <file>: quantize with the base tables learned by QuantTableOptimizer, the preset named after each coder is loaded
+         from file (coders without one keep the IJG tables)
+      -Y: decode the raw JPEG component planes and map them to depth in one pass, fusing libjpeg's colour conversion with the coder
+      -N <threshold>: decode HILBERT and MORTON picking, for pixels further than <threshold> from their neighbours, the nearby colour most consistent with them
       -?: display this message
 
     )use";
 }
 
 
-int ParseOptions(int argc, char** argv, string& inputFile, string& outFolder, string& algo, uint32_t& quality, string& outFormat)
+// Error bound the rate control searches the JPEG quality for, a bound <= 0 is not checked
+struct RateControl
+{
+    float MaxErr = 0.0f;
+    float Rmse = 0.0f;
+    // 0 searches a single quality for the whole image
+    uint32_t TileSize = 0;
+    // The search encodes one 8x8 block every SampleStep in both directions
+    uint32_t SampleStep = 4;
+
+    inline bool Enabled() const {return MaxErr > 0.0f || Rmse > 0.0f;}
+    inline bool Met(const ErrorStats& error) const
+    {
+        return (MaxErr <= 0.0f || error.Max <= MaxErr) && (Rmse <= 0.0f || error.Rmse <= Rmse);
+    }
+};
+
+// Median / outlier filter applied to the decoded depth, disabled when Window is 0
+struct PostFilter
+{
+    uint32_t Window = 0;
+    uint32_t Threshold = 0;
+    // Neighbour-consistent decode of the curve coders, disabled when 0
+    uint32_t ConsistentThreshold = 0;
+};
+
+// Raw component planes input, the coders write straight into the JPEG components
+struct RawPlanes
+{
+    bool Enabled = false;
+    PlaneBasis Basis = RGB_PLANES;
+    // Decode the raw planes, the colour conversion is done by the coder decode
+    bool FusedDecode = false;
+};
+
+// Channels of the encoded data stored as separate greyscale JPEGs, channel c at the tested quality + Offsets[c]
+struct ChannelSplit
+{
+    bool Enabled = false;
+    vector<int> Offsets;
+};
+
+// Per component scaling of the JPEG quantization tables: the coder presets, or Scales for every coder if given
+struct ComponentScaling
+{
+    bool Enabled = false;
+    vector<float> Scales;
+};
+
+// How decoded depth maps are saved
+struct DepthOutput
+{
+    bool SixteenBit = true;
+    int CompressionLevel = -1;
+};
+
+int ParseOptions(int argc, char** argv, string& inputFile, string& outFolder, string& algo, uint32_t& quality, string& outFormat,
+                 uint32_t& previewScale, bool& progressive, bool& multiQuality, bool& inMemory, bool& artifacts,
+                 bool& grid, uint32_t& threads, size_t& memoryBudget, vector<uint32_t>& quantizations, vector<uint32_t>& curveBits,
+                 RateControl& rateControl, PostFilter& postFilter, DepthOutput& depthOutput, RawPlanes& rawPlanes, bool& rgbx,
+                 ChannelSplit& channelSplit, ComponentScaling& componentScaling, string& presetFile,
+                 bool& arithmetic, string& huffmanFile,
+                 vector<JpegProfile>& profiles)
 {
     int c;
 
-    while ((c = getopt(argc, argv, "d:a::q::f::")) != -1) {
+    while ((c = getopt(argc, argv, "d:a::q::f::s:pmingt:b:Q:c:e:r:T:u:F:o:N:z:8y:YxS:k::P:AH:D:")) != -1) {
         switch (c) {
         case 'd':
         {
@@ -73,6 +176,16 @@ int ParseOptions(int argc, char** argv, string& inputFile, string& outFolder, st
                 algo = optarg;
                 break;
             }
+            else if (arg=="JPEG12")
+            {
+#ifdef DSTREAM_JPEG12
+                algo = optarg;
+                break;
+#else
+                cerr << "JPEG12 needs the 12 bit libjpeg-turbo build, rebuild with CONFIG+=jpeg12" << endl;
+                return -1;
+#endif
+            }
             else
             {
                 cerr << "Unknown algorithm " << arg << endl;
@@ -95,6 +208,168 @@ int ParseOptions(int argc, char** argv, string& inputFile, string& outFolder, st
                 outFormat = optarg;
             break;
         }
+        case 's':
+        {
+            int s = atoi(optarg);
+            if (s == 2 || s == 4 || s == 8)
+                previewScale = s;
+            else
+            {
+                cerr << "Preview scale must be 2, 4 or 8" << endl;
+                return -6;
+            }
+            break;
+        }
+        case 'p':
+            progressive = true;
+            break;
+        case 'm':
+            multiQuality = true;
+            break;
+        case 'i':
+            inMemory = true;
+            break;
+        case 'n':
+            artifacts = false;
+            break;
+        case 'g':
+            grid = true;
+            break;
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 'b':
+            memoryBudget = (size_t)atoll(optarg) * 1024 * 1024;
+            break;
+        case 'Q':
+            quantizations = ParseList(optarg);
+            break;
+        case 'c':
+            curveBits = ParseList(optarg);
+            break;
+        case 'e':
+            rateControl.MaxErr = atof(optarg);
+            break;
+        case 'r':
+            rateControl.Rmse = atof(optarg);
+            break;
+        case 'T':
+        {
+            int size = atoi(optarg);
+            if (size > 0 && size % 8 == 0)
+                rateControl.TileSize = size;
+            else
+            {
+                cerr << "Tile size must be a positive multiple of 8" << endl;
+                return -7;
+            }
+            break;
+        }
+        case 'u':
+            rateControl.SampleStep = std::max(1, atoi(optarg));
+            break;
+        case 'F':
+        {
+            int window = atoi(optarg);
+            if (window == 3 || window == 5)
+                postFilter.Window = window;
+            else
+            {
+                cerr << "Filter window must be 3 or 5" << endl;
+                return -8;
+            }
+            break;
+        }
+        case 'o':
+            postFilter.Threshold = atoi(optarg);
+            break;
+        case 'N':
+            postFilter.ConsistentThreshold = std::max(1, atoi(optarg));
+            break;
+        case 'z':
+            depthOutput.CompressionLevel = std::min(9, std::max(0, atoi(optarg)));
+            break;
+        case '8':
+            depthOutput.SixteenBit = false;
+            break;
+        case 'y':
+        {
+            std::string basis(optarg);
+            if (basis=="RGB" || basis=="YCbCr")
+            {
+                rawPlanes.Enabled = true;
+                rawPlanes.Basis = basis=="RGB" ? RGB_PLANES : YCBCR_PLANES;
+            }
+            else
+            {
+                cerr << "Plane basis must be RGB or YCbCr" << endl;
+                return -7;
+            }
+            break;
+        }
+        case 'Y':
+            rawPlanes.FusedDecode = true;
+            break;
+        case 'x':
+            rgbx = true;
+            break;
+        case 'S':
+        {
+            stringstream ss(optarg);
+            string item;
+
+            channelSplit.Enabled = true;
+            while (getline(ss, item, ','))
+                channelSplit.Offsets.push_back(atoi(item.c_str()));
+            break;
+        }
+        case 'k':
+        {
+            componentScaling.Enabled = true;
+            if (optarg == NULL)
+                break;
+
+            stringstream ss(optarg);
+            string item;
+            while (getline(ss, item, ','))
+                componentScaling.Scales.push_back(atof(item.c_str()));
+            break;
+        }
+        case 'P':
+            if (!filesystem::exists(optarg))
+            {
+                cerr << "Quantization table presets " << optarg << " not found" << endl;
+                return -8;
+            }
+            presetFile = optarg;
+            break;
+        case 'A':
+            arithmetic = true;
+            break;
+        case 'H':
+            if (!filesystem::exists(optarg))
+            {
+                cerr << "Huffman table presets " << optarg << " not found" << endl;
+                return -9;
+            }
+            huffmanFile = optarg;
+            break;
+        case 'D':
+        {
+            stringstream ss(optarg);
+            string item;
+            while (getline(ss, item, ','))
+            {
+                JpegProfile profile;
+                if (!JpegProfile::byName(item.c_str(), profile))
+                {
+                    cerr << "Unknown JPEG profile " << item << endl;
+                    return -10;
+                }
+                profiles.push_back(profile);
+            }
+            break;
+        }
         case '?': Usage(); return -1;
         default:
             cerr << "Unknown option: " << (char)c << endl;
@@ -122,322 +397,898 @@ int ParseOptions(int argc, char** argv, string& inputFile, string& outFolder, st
     return 0;
 }
 
+QVector<QRgb> LoadColorMap(string path)
+{
+    if (!filesystem::exists(path))
+        return {};
+
+    FILE* inFile = fopen(path.c_str(), "r");
+    string line;
+    QVector<QRgb> ret(256);
 
-void RemoveNoiseNaive(std::vector<uint16_t>& data, uint32_t width, uint32_t height)
+    fscanf(inFile, "%s\n", line.c_str());
+    for (uint32_t i=0; i<256; i++)
+    {
+        float scalar;
+        int r, g, b;
+
+        fscanf(inFile, "%f,%d,%d,%d\n", &scalar, &r, &g, &b);
+        ret[i] = qRgb(r,g,b);
+    }
+
+    return ret;
+}
+
+// Error texture, built a scanline at a time. Errors are mapped logarithmically to the 256 entries of the color map.
+void SaveErrorImage(const std::string& outPath, uint16_t* originalData, uint16_t* decodedData, uint32_t width, uint32_t height,
+                    QVector<QRgb> colorMap)
 {
+    static const vector<uint8_t> logTable = []() {
+        vector<uint8_t> ret(65536);
+        for (uint32_t e=0; e<65536; e++)
+            ret[e] = std::min(255.0, std::log2(1.0 + e) * 16.0);
+        return ret;
+    }();
+
+    QImage errorTexture(width, height, QImage::Format_Indexed8);
+    errorTexture.setColorTable(colorMap);
+
     for (uint32_t y=0; y<height; y++)
     {
+        uchar* line = errorTexture.scanLine(y);
+        const uint16_t* original = originalData + y * width;
+        const uint16_t* decoded = decodedData + y * width;
+
         for (uint32_t x=0; x<width; x++)
+            line[x] = logTable[abs(original[x] - decoded[x])];
+    }
+    errorTexture.save(QString(outPath.c_str()));
+}
+
+// Error texture, histogram and summary of an already analyzed decode
+void SaveError(const std::string& outPath, uint16_t* originalData, uint16_t* decodedData, uint32_t width, uint32_t height,
+               QVector<QRgb> colorMap, const ErrorStats& stats, const vector<uint32_t>& histogram)
+{
+    SaveErrorImage(outPath, originalData, decodedData, width, height, colorMap);
+    WriteErrorHistogram(outPath + "histogram.csv", histogram);
+
+    ofstream csv;
+    csv.open(outPath + ".txt", ios::out);
+    csv << "Max error: " << stats.Max << ", avg error: " << stats.Mean << ", RMSE: " << stats.Rmse << ", PSNR: " << stats.Psnr
+        << ", p50: " << stats.P50 << ", p99: " << stats.P99 << ", p99.9: " << stats.P999;
+    csv.close();
+}
+
+uint16_t* Quantize(uint16_t* input, uint32_t nElements, uint32_t quantization)
+{
+    uint16_t* ret = new uint16_t[nElements];
+    for (uint32_t i=0; i<nElements; i++)
+        ret[i] = (input[i] >> (16 - quantization)) << (16 - quantization);
+    return ret;
+}
+
+// Box filter matching the area covered by each pixel of a 1/scale DCT-scaled decode
+vector<uint16_t> Downsample(uint16_t* input, uint32_t width, uint32_t height, uint32_t scale, uint32_t& outWidth, uint32_t& outHeight)
+{
+    outWidth = (width + scale - 1) / scale;
+    outHeight = (height + scale - 1) / scale;
+    vector<uint16_t> ret(outWidth * outHeight);
+
+    for (uint32_t y=0; y<outHeight; y++)
+    {
+        for (uint32_t x=0; x<outWidth; x++)
         {
-            if (y != 0 && x != 0 && x != (width-1) && y != (height-1))
-            {
-                int current = data[x + y * width];
-                // Get all neighbors
-                std::vector<int> neighbors;
-                neighbors.push_back(data[x+1 + y * width]);
-                neighbors.push_back(data[x-1 + y * width]);
-                neighbors.push_back(data[x + (y+1) * width]);
-                neighbors.push_back(data[x + (y-1) * width]);
-
-                // Compute distance matrix
-                int distanceMatrix[4][4];
-                int outlierThreshold = 1000;
-
-                for (int i=0; i<4; i++)
-                    for (int j=0; j<4; j++)
-                        distanceMatrix[i][j] = std::abs(neighbors[i] - neighbors[j]);
-
-                uint32_t outliers = 0;
-                // Check if there's an outlier
-                for (uint32_t i=0; i<4; i++)
-                    if (distanceMatrix[i][0] > outlierThreshold)
-                        outliers++;
-
-                // Find the right outliers (for each neighbor, return the one with the biggest row + column sum)
-                std::vector<int> outliersIdx;
-
-                for (uint32_t i=0; i<outliers; i++)
-                {
-                    int currOutlier = -1;
-                    int maxSum = -1;
-                    for (uint32_t j=0; j<4; j++)
-                    {
-                        // Compute row + column
-                        int row = 0, col = 0;
-                        for (uint32_t k=0; k<4; k++)
-                        {
-                            row += distanceMatrix[j][k];
-                            col += distanceMatrix[k][j];
-                        }
+            uint32_t sum = 0, n = 0;
+            for (uint32_t sy=y*scale; sy<std::min((y+1)*scale, height); sy++)
+                for (uint32_t sx=x*scale; sx<std::min((x+1)*scale, width); sx++, n++)
+                    sum += input[sx + sy*width];
+            ret[x + y*outWidth] = sum / n;
+        }
+    }
 
-                        if ((row + col) > maxSum && !std::count(outliersIdx.begin(), outliersIdx.end(), j))
-                        {
-                            currOutlier = j;
-                            maxSum = row + col;
-                        }
-                    }
-                    if (currOutlier != -1)
-                        outliersIdx.push_back(currOutlier);
-                }
+    return ret;
+}
+
+struct CoderParams
+{
+    string Algorithm;
+    uint32_t Quantization;
+    uint32_t CurveBits = 0;
+    // Encoded data as 4 byte RGBX pixels instead of RGB
+    bool Rgbx = false;
+    // Quantization scale of each JPEG component, empty for the plain quality tables
+    vector<float> ComponentScales = {};
+    // Base quantization tables of the JPEG components, empty for the IJG ones
+    vector<vector<uint16_t>> QuantTables = {};
+    // Arithmetic instead of Huffman entropy coding of the JPEG
+    bool Arithmetic = false;
+    // Huffman tables: optimized for each image, the standard ones, or fixed ones if Huffman isn't empty
+    bool OptimizeHuffman = true;
+    HuffmanTables Huffman = {};
+    // libjpeg DCT method, upsampling and block smoothing used to encode and decode
+    JpegProfile Profile = {};
+};
+
+// Row filter used when storing a coder's output as PNG. A fixed filter is used where it is within about 1% of the
+// adaptive choice on DEMs, Hilbert jumps between cells too often for any single one.
+PngFilter DefaultPngFilter(const string& algo)
+{
+    if (!algo.compare("PACKED") || !algo.compare("SPLIT") || !algo.compare("TRIANGLE"))
+        return UP;
+    if (!algo.compare("MORTON") || !algo.compare("PHASE"))
+        return AVERAGE;
+    return ADAPTIVE;
+}
+
+// Channels holding data, the others are left at 0 by the coder
+uint32_t UsedChannels(const string& algo)
+{
+    if (!algo.compare("PACKED") || !algo.compare("SPLIT") || !algo.compare("PHASE"))
+        return 2;
+    return 3;
+}
+
+vector<uint32_t> ChannelQualities(const ChannelSplit& split, const string& algo, uint32_t quality)
+{
+    vector<uint32_t> ret;
+    for (uint32_t c=0; c<UsedChannels(algo); c++)
+    {
+        int offset = c < split.Offsets.size() ? split.Offsets[c] : 0;
+        ret.push_back(std::min(100, std::max(1, (int)quality + offset)));
+    }
+    return ret;
+}
+
+size_t TotalSize(const vector<vector<uint8_t>>& buffers)
+{
+    size_t ret = 0;
+    for (auto& buffer : buffers)
+        ret += buffer.size();
+    return ret;
+}
+
+vector<float> ComponentScales(const ComponentScaling& scaling, const string& algo)
+{
+    if (!scaling.Enabled)
+        return {};
+    return scaling.Scales.empty() ? ComponentScalePreset(algo) : scaling.Scales;
+}
 
-                // Compute the average withouit maxIdx
-                float avg = 0; float divisor = 4 - outliersIdx.size();
-                for (uint32_t i=0; i<4; i++)
-                    if (!std::count(outliersIdx.begin(), outliersIdx.end(), i))
-                        avg += neighbors[i];
-                avg /= divisor;
+// Quantization tables of a coder: its learned preset if any, then the component scales
+void SetQuantization(CoderParams& params, const ComponentScaling& scaling, const string& presetFile)
+{
+    params.ComponentScales = ComponentScales(scaling, params.Algorithm);
+    if (presetFile.compare(""))
+        JpegEncoder::loadPresetTables(presetFile.c_str(), params.Algorithm.c_str(), params.QuantTables);
+}
+
+void ConfigureEncoder(JpegEncoder& encoder, const CoderParams& params)
+{
+    encoder.setBaseTables(params.QuantTables);
+    encoder.setComponentScales(params.ComponentScales);
+    encoder.setArithmetic(params.Arithmetic);
+    encoder.setOptimize(params.OptimizeHuffman);
+    encoder.setHuffmanTables(params.Huffman);
+    encoder.setProfile(params.Profile);
+}
+
+// JPEG12 isn't a colour coder: the encoded data is one 12 bit sample per pixel, stored in 16 bits
+bool IsJpeg12(const CoderParams& params)
+{
+    return !params.Algorithm.compare("JPEG12");
+}
+
+uint32_t EncodedPixelSize(const CoderParams& params)
+{
+    if (IsJpeg12(params))
+        return 2;
+    return params.Rgbx ? 4 : 3;
+}
+
+// Parameters used by the serial benchmark: Hilbert at (14,3), Morton at (q,6), JPEG12 at most at 12 bits
+CoderParams DefaultParams(const string& algo, uint32_t quantization)
+{
+    if (!algo.compare("HILBERT"))
+        return {algo, 14, 3};
+    if (!algo.compare("MORTON"))
+        return {algo, quantization, 6};
+    if (!algo.compare("JPEG12"))
+        return {algo, std::min(quantization, 12u), 0};
+    return {algo, quantization, 0};
+}
+
+bool IsValid(const CoderParams& params)
+{
+    if (IsJpeg12(params))
+        return params.Quantization > 0 && params.Quantization <= 12;
+    return IsValidCoder(params.Algorithm, params.Quantization, params.CurveBits);
+}
+
+// Calls f with the coder described by params, for the kernels templated on the coder
+template <typename F>
+void WithCoder(const CoderParams& params, F f)
+{
+    DStream::WithCoder(params.Algorithm, params.Quantization, params.CurveBits, f);
+}
+
+void EncodeData(const CoderParams& params, uint16_t* values, uint8_t* dest, uint32_t count)
+{
+    const string& algo = params.Algorithm;
+    if (params.Rgbx && !IsJpeg12(params))
+    {
+        WithCoder(params, [&](auto& coder) { coder.EncodeRgbx(values, (uint32_t*)dest, count); });
+        return;
+    }
+
+    if (!algo.compare("MORTON"))
+    {
+        MortonCoder c(params.Quantization, params.CurveBits);
+        c.Encode(values, dest, count);
+    }
+    else if (!algo.compare("HILBERT"))
+    {
+        HilbertCoder c(params.Quantization, params.CurveBits);
+        c.Encode(values, dest, count);
+    }
+    else if (!algo.compare("PACKED"))
+    {
+        PackedCoder c(params.Quantization);
+        c.Encode(values, dest, count);
+    }
+    else if (!algo.compare("SPLIT"))
+    {
+        SplitCoder c(params.Quantization);
+        c.Encode(values, dest, count);
+    }
+    else if (!algo.compare("PHASE"))
+    {
+        PhaseCoder c(params.Quantization);
+        c.Encode(values, dest, count);
+    }
+    else if (!algo.compare("TRIANGLE"))
+    {
+        TriangleCoder c(params.Quantization);
+        c.Encode(values, dest, count);
+    }
+    else if (!algo.compare("JPEG12"))
+    {
+        uint16_t* samples = (uint16_t*)dest;
+        for (uint32_t i=0; i<count; i++)
+            samples[i] = values[i] >> 4;
+    }
+}
+
+void DecodeData(const CoderParams& params, uint8_t* values, uint16_t* dest, uint32_t count)
+{
+    const string& algo = params.Algorithm;
+    if (params.Rgbx && !IsJpeg12(params))
+    {
+        WithCoder(params, [&](auto& coder) { coder.DecodeRgbx((uint32_t*)values, dest, count); });
+        return;
+    }
+
+    if (!algo.compare("MORTON"))
+    {
+        MortonCoder c(params.Quantization, params.CurveBits);
+        c.Decode(values, dest, count);
+    }
+    else if (!algo.compare("HILBERT"))
+    {
+        HilbertCoder c(params.Quantization, params.CurveBits);
+        c.Decode(values, dest, count);
+    }
+    else if (!algo.compare("PACKED"))
+    {
+        PackedCoder c(params.Quantization);
+        c.Decode(values, dest, count);
+    }
+    else if (!algo.compare("SPLIT"))
+    {
+        SplitCoder c(params.Quantization);
+        c.Decode(values, dest, count);
+    }
+    else if (!algo.compare("PHASE"))
+    {
+        PhaseCoder c(params.Quantization);
+        c.Decode(values, dest, count);
+    }
+    else if (!algo.compare("TRIANGLE"))
+    {
+        TriangleCoder c(params.Quantization);
+        c.Decode(values, dest, count);
+    }
+    else if (!algo.compare("JPEG12"))
+    {
+        const uint16_t* samples = (const uint16_t*)values;
+        for (uint32_t i=0; i<count; i++)
+            dest[i] = samples[i] << 4;
+    }
+}
+
+// Coder output as padded JPEG component planes, stored one after the other in dest
+void EncodeDataPlanes(const CoderParams& params, uint16_t* values, uint32_t width, uint32_t height, PlaneBasis basis,
+                      vector<uint8_t>& dest)
+{
+    uint32_t stride = JpegEncoder::paddedSize(width);
+    uint32_t planeSize = stride * JpegEncoder::paddedSize(height);
+    dest.resize(planeSize * 3);
+    uint8_t* planes[3] = {dest.data(), dest.data() + planeSize, dest.data() + planeSize * 2};
+
+    WithCoder(params, [&](auto& coder) { EncodePlanes(coder, values, planes, width, height, stride, basis); });
+}
+
+// Depth from the raw component planes of a decoded JPEG, stride x padded height samples each
+void DecodeDataPlanes(const CoderParams& params, vector<uint8_t>& planeData, uint32_t stride, PlaneBasis basis, uint16_t* dest,
+                      uint32_t width, uint32_t height)
+{
+    size_t planeSize = planeData.size() / 3;
+    const uint8_t* planes[3] = {planeData.data(), planeData.data() + planeSize, planeData.data() + planeSize * 2};
+
+    WithCoder(params, [&](auto& coder) { DecodePlanes(coder, planes, dest, width, height, stride, basis); });
+}
+
+// Raw component planes of a JPEG, libjpeg stops after the IDCT. Returns false if the JPEG can't be decoded to planes
+// (chroma subsampled or not 3 components), the caller then falls back to the interleaved DecodeJpeg.
+bool DecodeJpegPlanes(vector<uint8_t>& jpegData, vector<uint8_t>& planeData, uint32_t& stride)
+{
+    JpegDecoder decoder;
+    int decodedWidth, decodedHeight, decodedStride;
+
+    if (!decoder.decodePlanes(jpegData.data(), jpegData.size(), planeData, decodedWidth, decodedHeight, decodedStride))
+        return false;
+    stride = decodedStride;
+    return planeData.size() == (size_t)stride * ((decodedHeight + DCTSIZE - 1) / DCTSIZE * DCTSIZE) * 3;
+}
+
+// JPEG colour space holding the coder channels
+J_COLOR_SPACE JpegColorSpace(PlaneBasis basis)
+{
+    return basis == YCBCR_PLANES ? J_COLOR_SPACE::JCS_YCbCr : J_COLOR_SPACE::JCS_RGB;
+}
+
+void EncodeJpegPlanes(vector<uint8_t>& planeData, uint32_t width, uint32_t height, uint32_t quality, bool progressive,
+                      PlaneBasis basis, vector<uint8_t>& dest, const CoderParams& params)
+{
+    JpegEncoder encoder;
+    uint8_t* buffer = nullptr;
+    int length = 0;
+    size_t planeSize = planeData.size() / 3;
+    uint8_t* planes[3] = {planeData.data(), planeData.data() + planeSize, planeData.data() + planeSize * 2};
+
+    encoder.setJpegColorSpace(JpegColorSpace(basis));
+    encoder.setQuality(quality);
+    ConfigureEncoder(encoder, params);
+    encoder.setProgressive(progressive);
+    encoder.encodePlanes(planes, width, height, buffer, length);
+
+    dest.assign(buffer, buffer + length);
+    free(buffer);
+}
+
+// JPEG of the encoded data: RGB (3 byte RGB or 4 byte RGBX pixels) for the colour coders, 12 bit greyscale for JPEG12
+void EncodeJpeg(const CoderParams& params, uint8_t* data, uint32_t width, uint32_t height, uint32_t quality, bool progressive,
+                vector<uint8_t>& dest)
+{
+#ifdef DSTREAM_JPEG12
+    if (IsJpeg12(params))
+    {
+        Jpeg12Codec codec;
+        codec.setQuality(quality);
+        codec.setProgressive(progressive);
+        codec.encode((const uint16_t*)data, width, height, dest);
+        return;
+    }
+#endif
+    JpegEncoder encoder;
+    uint8_t* buffer = nullptr;
+    int length = 0;
+
+    if (params.Rgbx)
+        encoder.setColorSpace(J_COLOR_SPACE::JCS_EXT_RGBX, 4);
+    encoder.setJpegColorSpace(J_COLOR_SPACE::JCS_RGB);
+    encoder.setQuality(quality);
+    ConfigureEncoder(encoder, params);
+    encoder.setProgressive(progressive);
+    encoder.encode(data, width, height, buffer, length);
+
+    dest.assign(buffer, buffer + length);
+    free(buffer);
+}
+
+// Decoded JPEG in the layout of the encoded data, allocated with new[]. arithmeticCoded, if given, is set to the
+// entropy coding the JPEG was read with.
+uint8_t* DecodeJpeg(const CoderParams& params, vector<uint8_t>& jpegData, PlaneBasis basis = RGB_PLANES,
+                    bool* arithmeticCoded = nullptr)
+{
+    uint8_t* bits = nullptr;
+    int decodedWidth, decodedHeight;
+#ifdef DSTREAM_JPEG12
+    if (IsJpeg12(params))
+    {
+        Jpeg12Codec codec;
+        vector<uint16_t> samples;
+        codec.decode(jpegData.data(), jpegData.size(), samples, decodedWidth, decodedHeight);
+        bits = new uint8_t[samples.size() * sizeof(uint16_t)];
+        memcpy(bits, samples.data(), samples.size() * sizeof(uint16_t));
+        if (arithmeticCoded)
+            *arithmeticCoded = false;
+        return bits;
+    }
+#endif
+    JpegDecoder decoder;
+    if (params.Rgbx)
+        decoder.setColorSpace(J_COLOR_SPACE::JCS_EXT_RGBX);
+    decoder.setJpegColorSpace(JpegColorSpace(basis));
+    decoder.setProfile(params.Profile);
+    decoder.decode(jpegData.data(), jpegData.size(), bits, decodedWidth, decodedHeight);
+    if (arithmeticCoded)
+        *arithmeticCoded = decoder.arithmeticCoded();
+    return bits;
+}
+
+// Decode of a whole image, neighbour-consistent for the curve coders if requested
+void DecodeImage(const CoderParams& params, const PostFilter& filter, uint8_t* values, uint16_t* dest, uint32_t width, uint32_t height)
+{
+    if (filter.ConsistentThreshold && !params.Algorithm.compare("HILBERT"))
+        HilbertCoder(params.Quantization, params.CurveBits).DecodeConsistent(values, dest, width, height, filter.ConsistentThreshold,
+                                                                             EncodedPixelSize(params));
+    else if (filter.ConsistentThreshold && !params.Algorithm.compare("MORTON"))
+        MortonCoder(params.Quantization, params.CurveBits).DecodeConsistent(values, dest, width, height, filter.ConsistentThreshold,
+                                                                           EncodedPixelSize(params));
+    else
+        DecodeData(params, values, dest, width * height);
+}
+
+void WriteStageHeader(ostream& out)
+{
+    for (uint32_t s=0; s<STAGE_COUNT; s++)
+    {
+        const char* name = StageName((Stage)s);
+        out << "," << name << "WallNs," << name << "CpuNs," << name << "NsPerPixel," << name << "MBps,"
+            << name << "Mpixps," << name << "PeakRssKB";
+    }
+}
+
+// Peak RSS isn't measured for concurrent stages, left empty in CSV and null in JSON
+string PeakRss(const StageStats& stage, const char* missing)
+{
+    return stage.PeakRssKB ? to_string(stage.PeakRssKB) : missing;
+}
+
+void WriteStageValues(ostream& out, const StageStats* stages)
+{
+    for (uint32_t s=0; s<STAGE_COUNT; s++)
+        out << "," << stages[s].WallNs << "," << stages[s].CpuNs << "," << stages[s].NsPerPixel() << "," << stages[s].MBps()
+            << "," << stages[s].Mpixps() << "," << PeakRss(stages[s], "");
+}
+
+// JSON has no infinity, the PSNR of a lossless decode is written as null
+string JsonNumber(double value)
+{
+    if (std::isinf(value))
+        return "null";
+
+    stringstream ss;
+    ss << value;
+    return ss.str();
+}
+
+void WriteStageJson(ostream& out, const StageStats* stages)
+{
+    out << "{";
+    for (uint32_t s=0; s<STAGE_COUNT; s++)
+        out << (s ? ", " : "") << "\"" << StageName((Stage)s) << "\": {\"wallNs\": " << stages[s].WallNs << ", \"cpuNs\": "
+            << stages[s].CpuNs << ", \"nsPerPixel\": " << stages[s].NsPerPixel() << ", \"MBps\": " << stages[s].MBps()
+            << ", \"Mpixps\": " << stages[s].Mpixps() << ", \"peakRssKB\": " << PeakRss(stages[s], "null") << "}";
+    out << "}";
+}
+
+struct GridResult
+{
+    CoderParams Params;
+    uint32_t Quality;
+    ErrorStats Error;
+    size_t Bytes;
+    StageStats Stages[STAGE_COUNT];
+};
+
+// Memory held at once by RunGridPoint: quantized input, coder output (interleaved or padded planes), the JPEG itself
+// (at most as large as its input), the decoded pixels or planes and the decoded depth
+size_t GridPointMemory(const CoderParams& params, const PostFilter& filter, const RawPlanes& rawPlanes, uint32_t width,
+                       uint32_t height)
+{
+    size_t nElements = (size_t)width * height;
+    size_t planesSize = (size_t)JpegEncoder::paddedSize(width) * JpegEncoder::paddedSize(height) * 3;
+    size_t interleavedSize = nElements * EncodedPixelSize(params);
+    bool usePlanes = rawPlanes.Enabled && !IsJpeg12(params);
+    bool fusedDecode = rawPlanes.FusedDecode && !IsJpeg12(params) && !filter.ConsistentThreshold;
+    size_t encodedSize = usePlanes ? planesSize : interleavedSize;
+
+    return nElements * 2 + encodedSize * 2 + (fusedDecode ? planesSize : interleavedSize) + nElements * 2;
+}
+
+// Full in-memory round trip of a single grid point, safe to run concurrently with other points (its stages are timed
+// as concurrent: thread CPU time, no peak RSS)
+void RunGridPoint(uint16_t* originalData, uint32_t width, uint32_t height, const PostFilter& filter, const RawPlanes& rawPlanes,
+                  GridResult& result)
+{
+    uint32_t nElements = width * height;
+    bool usePlanes = rawPlanes.Enabled && !IsJpeg12(result.Params);
+    bool fusedDecode = rawPlanes.FusedDecode && !IsJpeg12(result.Params) && !filter.ConsistentThreshold;
+    PlaneBasis basis = usePlanes ? rawPlanes.Basis : RGB_PLANES;
+    vector<uint8_t> encoded(usePlanes ? 0 : nElements * EncodedPixelSize(result.Params), 0);
+    vector<uint8_t> decodedPlanes;
+    uint32_t planeStride = 0;
+    vector<uint16_t> decoded(nElements, 0);
+    vector<uint8_t> jpegData;
+    uint8_t* bits = nullptr;
+
+    uint16_t* quantizedData = Quantize(originalData, nElements, result.Params.Quantization);
+    {
+        StageTimer timer(result.Stages[CODER_ENCODE], nElements, nElements * 2, true);
+        if (usePlanes)
+            EncodeDataPlanes(result.Params, quantizedData, width, height, rawPlanes.Basis, encoded);
+        else
+            EncodeData(result.Params, quantizedData, encoded.data(), nElements);
+    }
+    delete[] quantizedData;
+
+    {
+        StageTimer timer(result.Stages[JPEG_ENCODE], nElements, nElements * 3, true);
+        if (usePlanes)
+            EncodeJpegPlanes(encoded, width, height, result.Quality, false, rawPlanes.Basis, jpegData, result.Params);
+        else
+            EncodeJpeg(result.Params, encoded.data(), width, height, result.Quality, false, jpegData);
+    }
+    {
+        StageTimer timer(result.Stages[JPEG_DECODE], nElements, jpegData.size(), true);
+        if (fusedDecode)
+            fusedDecode = DecodeJpegPlanes(jpegData, decodedPlanes, planeStride);
+        if (!fusedDecode)
+            bits = DecodeJpeg(result.Params, jpegData, basis);
+    }
+    {
+        StageTimer timer(result.Stages[CODER_DECODE], nElements, nElements * 3, true);
+        if (fusedDecode)
+            DecodeDataPlanes(result.Params, decodedPlanes, planeStride, basis, decoded.data(), width, height);
+        else
+            DecodeImage(result.Params, filter, bits, decoded.data(), width, height);
+    }
+    delete[] bits;
 
-                float err = std::abs(current - avg);
+    if (filter.Window)
+    {
+        StageTimer timer(result.Stages[POST_FILTER], nElements, nElements * 2, true);
+        MedianFilter(decoded.data(), width, height, filter.Window, filter.Threshold, 1);
+    }
 
-                if (err > 8)
-                    data[x + y*width] = avg;
-                else
-                    data[x + y*width] = current;
-            }
-        }
+    {
+        StageTimer timer(result.Stages[ERROR_ANALYSIS], nElements, nElements * 4, true);
+        // Grid points already run in parallel
+        result.Error = AnalyzeError(originalData, decoded.data(), nElements, 1);
     }
+    result.Bytes = jpegData.size();
 }
 
-
-void RemoveNoiseMedian(std::vector<uint16_t>& data, uint32_t width, uint32_t height)
+void RunGrid(const string& outFolder, uint16_t* originalData, uint32_t width, uint32_t height, const vector<string>& algorithms,
+             const vector<uint32_t>& qualities, const vector<uint32_t>& quantizations, const vector<uint32_t>& curveBits,
+             uint32_t threads, size_t memoryBudget, const PostFilter& filter, const RawPlanes& rawPlanes, bool rgbx,
+             const ComponentScaling& scaling, const string& presetFile, const StageStats& parsing)
 {
-    int halfWind = 1;
-    for (int y=0; y<height; y++)
+    // Results are stored by grid index, so the output doesn't depend on the order in which tasks complete
+    vector<GridResult> results;
+    for (auto& algo : algorithms)
     {
-        for (int x=0; x<width; x++)
+        bool usesCurve = !algo.compare("HILBERT") || !algo.compare("MORTON");
+        for (uint32_t quantization : quantizations)
         {
-            // Compute distance sqrt(matrix size)
-            int matSize = (halfWind * 2 + 1) * (halfWind * 2 + 1);
-            bool removed = false;
-            if (y - halfWind < 0 || y+halfWind >= height)
-            {
-                matSize -= halfWind * 2 + 1;
-                removed = true;
-            }
-            if (x - halfWind < 0 || x+halfWind >= width)
-            {
-                if (!removed)
-                    matSize -= halfWind * 2 + 1;
-                else
-                    matSize -= halfWind * 2;
-            }
-
-            // Get all neighbors
-            std::vector<int> neighbors;
-
-            int current = data[x + y * width];
-            for (int i=-halfWind; i<=halfWind; i++)
-            {
-                for (int j=-halfWind; j<=halfWind; j++)
-                {
-                    int xCoord = x + j;
-                    int yCoord = (y+i);
-                    if (xCoord >= 0 && xCoord < width && yCoord >= 0 && yCoord < height)
-                        neighbors.push_back(data[xCoord + yCoord*width]);
-                }
-            }
-
-            // Compute distance matrix
-            int distanceMatrix[matSize][matSize];
-            int outlierThreshold = 750;
-
-            for (int i=0; i<matSize; i++)
-                for (int j=0; j<matSize; j++)
-                    distanceMatrix[i][j] = std::abs(neighbors[i] - neighbors[j]);
-
-            uint32_t outliers = 0;
-            // Check if there's an outlier
-            for (uint32_t i=0; i<matSize; i++)
-                if (distanceMatrix[i][0] > outlierThreshold)
-                    outliers++;
-
-            // Find the right outliers (for each neighbor, return the one with the biggest row + column sum)
-            std::vector<int> outliersIdx;
-
-            for (uint32_t i=0; i<outliers; i++)
+            for (uint32_t bits : usesCurve ? curveBits : vector<uint32_t>{0})
             {
-                int currOutlier = -1;
-                int maxSum = -1;
-                for (int j=0; j<matSize; j++)
+                CoderParams params = {algo, quantization, bits, rgbx};
+                SetQuantization(params, scaling, presetFile);
+                if (!IsValid(params))
+                    continue;
+                for (uint32_t q : qualities)
                 {
-                    // Compute row + column
-                    int row = 0, col = 0;
-                    for (int k=0; k<matSize; k++)
-                    {
-                        row += distanceMatrix[j][k];
-                        col += distanceMatrix[k][j];
-                    }
-
-                    if ((row + col) > maxSum && !std::count(outliersIdx.begin(), outliersIdx.end(), j))
-                    {
-                        currOutlier = j;
-                        maxSum = row + col;
-                    }
+                    results.push_back({params, q, ErrorStats(), 0, {}});
+                    results.back().Stages[PARSING] = parsing;
                 }
-                if (currOutlier != -1)
-                    outliersIdx.push_back(currOutlier);
             }
+        }
+    }
 
-            std::vector<uint16_t> goodNeighbors;
-            for (int i=0; i<neighbors.size(); i++)
-                if (!std::count(outliersIdx.begin(), outliersIdx.end(), i))
-                    goodNeighbors.push_back(neighbors[i]);
+    ThreadPool pool(threads, memoryBudget);
+    cout << "Running " << results.size() << " grid points on " << pool.GetThreadCount() << " threads" << endl;
 
+    for (auto& result : results)
+        pool.Submit([&result, &filter, &rawPlanes, originalData, width, height]() {
+                        RunGridPoint(originalData, width, height, filter, rawPlanes, result);
+                    }, GridPointMemory(result.Params, filter, rawPlanes, width, height));
+    pool.Wait();
 
-            // Compute the average without maxIdx
-            float avg = 0;
-            for (uint32_t i=0; i<goodNeighbors.size(); i++)
-                avg += goodNeighbors[i];
-            avg /= goodNeighbors.size();
+    ofstream csv(outFolder + "/Grid.csv", ios::out);
+    ofstream json(outFolder + "/Grid.json", ios::out);
 
-            float err = std::abs(current - avg);
-            std::sort(goodNeighbors.begin(), goodNeighbors.end());
+    csv << "Algorithm,Quantization,CurveBits,Quality,Bytes,Bpp,Max,Avg,Rmse,Psnr,P50,P99,P999";
+    WriteStageHeader(csv);
+    csv << endl;
+    json << "[" << endl;
+    for (size_t i=0; i<results.size(); i++)
+    {
+        const GridResult& r = results[i];
+        double bpp = r.Bytes * 8.0 / (width * height);
+        csv << r.Params.Algorithm << "," << r.Params.Quantization << "," << r.Params.CurveBits << "," << r.Quality << ","
+            << r.Bytes << "," << bpp << "," << r.Error.Max << "," << r.Error.Mean << "," << r.Error.Rmse << "," << r.Error.Psnr << ","
+            << r.Error.P50 << "," << r.Error.P99 << "," << r.Error.P999;
+        WriteStageValues(csv, r.Stages);
+        csv << endl;
+        json << "    {\"algorithm\": \"" << r.Params.Algorithm << "\", \"quantization\": " << r.Params.Quantization
+             << ", \"curveBits\": " << r.Params.CurveBits << ", \"quality\": " << r.Quality << ", \"bytes\": " << r.Bytes
+             << ", \"bpp\": " << bpp << ", \"max\": " << r.Error.Max << ", \"avg\": " << r.Error.Mean << ", \"rmse\": "
+             << r.Error.Rmse << ", \"psnr\": " << JsonNumber(r.Error.Psnr) << ", \"p50\": " << r.Error.P50 << ", \"p99\": "
+             << r.Error.P99 << ", \"p999\": " << r.Error.P999 << ", \"stages\": ";
+        WriteStageJson(json, r.Stages);
+        json << "}" << (i + 1 < results.size() ? "," : "") << endl;
+    }
+    json << "]" << endl;
 
-            if (err > 750)
-                data[x + y*width] = goodNeighbors[goodNeighbors.size() / 2];
-            else
-                data[x + y*width] = current;
+    // One rate-distortion curve per coder configuration, results of the same configuration are contiguous
+    vector<RDCurve> rdCurves;
+    for (size_t i=0; i<results.size(); i++)
+    {
+        const GridResult& r = results[i];
+        if (i == 0 || r.Params.Algorithm != results[i-1].Params.Algorithm || r.Params.Quantization != results[i-1].Params.Quantization ||
+            r.Params.CurveBits != results[i-1].Params.CurveBits)
+        {
+            stringstream name;
+            name << r.Params.Algorithm << "_" << r.Params.Quantization;
+            if (r.Params.CurveBits)
+                name << "_" << r.Params.CurveBits;
+            rdCurves.push_back({name.str(), {}});
         }
+        rdCurves.back().Points.push_back({r.Quality, r.Bytes, r.Bytes * 8.0 / (width * height), r.Error.Rmse, r.Error.Psnr, r.Error.Max});
     }
+    WriteRDCsv(outFolder + "/RD.csv", rdCurves);
+    WriteRDJson(outFolder + "/RD.json", rdCurves);
+    WriteBDRateCsv(outFolder + "/BDRate.csv", rdCurves);
 }
 
-QVector<QRgb> LoadColorMap(string path)
+struct TileResult
 {
-    if (!filesystem::exists(path))
-        return {};
-
-    FILE* inFile = fopen(path.c_str(), "r");
-    string line;
-    QVector<QRgb> ret(256);
+    uint32_t X, Y, Width, Height;
+    uint32_t Quality = 100;
+    size_t Bytes = 0;
+    uint32_t Encodes = 0;
+    bool Met = false;
+    ErrorStats Error;
+};
+
+// In-memory round trip of a tile at the given quality. With step > 1 only one 8x8 block every step in both directions
+// is gathered into a smaller image, which goes through the encoder, the decoder and the error analysis: without chroma
+// subsampling a block decodes to the same pixels wherever it is, so the estimate is exact on the blocks it covers.
+// bytes is the size of the JPEG that was encoded, so only meaningful with step == 1; then the decoded depth is also
+// written to decoded, if given.
+ErrorStats EvaluateTile(const CoderParams& params, uint8_t* rgb, uint16_t* original, uint32_t width, uint32_t height,
+                        uint32_t quality, uint32_t step, size_t& bytes, uint16_t* decoded = nullptr)
+{
+    const uint32_t block = 8;
+    uint32_t pixelSize = EncodedPixelSize(params);
+    uint32_t blocksX = (width / block + step - 1) / step;
+    uint32_t blocksY = (height / block + step - 1) / step;
 
-    fscanf(inFile, "%s\n", line.c_str());
-    for (uint32_t i=0; i<256; i++)
+    // Tiles without a whole block to sample are evaluated in full
+    if (step == 1 || blocksX == 0 || blocksY == 0)
     {
-        float scalar;
-        int r, g, b;
+        vector<uint8_t> jpegData;
+        EncodeJpeg(params, rgb, width, height, quality, false, jpegData);
+        uint8_t* bits = DecodeJpeg(params, jpegData);
+        bytes = jpegData.size();
+
+        vector<uint16_t> decodedData(width * height);
+        DecodeData(params, bits, decodedData.data(), decodedData.size());
+        delete[] bits;
+        if (decoded && step == 1)
+            std::copy(decodedData.begin(), decodedData.end(), decoded);
+
+        return AnalyzeError(original, decodedData.data(), decodedData.size(), 1);
+    }
 
-        fscanf(inFile, "%f,%d,%d,%d\n", &scalar, &r, &g, &b);
-        ret[i] = qRgb(r,g,b);
+    uint32_t sampledWidth = blocksX * block, sampledHeight = blocksY * block;
+    vector<uint8_t> sampledColors(sampledWidth * sampledHeight * pixelSize);
+    vector<uint16_t> sampledOriginal(sampledWidth * sampledHeight);
+    for (uint32_t by=0; by<blocksY; by++)
+    {
+        for (uint32_t y=0; y<block; y++)
+        {
+            for (uint32_t bx=0; bx<blocksX; bx++)
+            {
+                uint32_t src = bx * step * block + (by * step * block + y) * width;
+                uint32_t dst = bx * block + (by * block + y) * sampledWidth;
+                memcpy(sampledColors.data() + dst * pixelSize, rgb + src * pixelSize, block * pixelSize);
+                memcpy(sampledOriginal.data() + dst, original + src, block * sizeof(uint16_t));
+            }
+        }
     }
 
-    return ret;
+    vector<uint8_t> jpegData;
+    EncodeJpeg(params, sampledColors.data(), sampledWidth, sampledHeight, quality, false, jpegData);
+    uint8_t* bits = DecodeJpeg(params, jpegData);
+    bytes = jpegData.size();
+
+    vector<uint16_t> sampledDecoded(sampledOriginal.size());
+    DecodeData(params, bits, sampledDecoded.data(), sampledDecoded.size());
+    delete[] bits;
+
+    return AnalyzeError(sampledOriginal.data(), sampledDecoded.data(), sampledOriginal.size(), 1);
 }
 
-void SaveError(const std::string& outPath, uint16_t* originalData, uint16_t* decodedData, uint32_t width, uint32_t height,
-               QVector<QRgb> colorMap, float& maxErr, float& avgErr)
+// Binary search of the lowest quality meeting the target on the subsampled error, then the result is checked on every
+// pixel and the quality raised until it passes (the samples may miss the worst pixels)
+void SearchTile(const CoderParams& params, uint8_t* rgb, uint16_t* original, const RateControl& control, TileResult& tile,
+                uint16_t* decoded)
 {
-    uint32_t nElements = width * height;
-    vector<uint16_t> errorTextureData(nElements);
-    unordered_map<uint16_t, int> errorFrequencies;
-    QImage errorTexture(width, height, QImage::Format_Indexed8);
-    errorTexture.setColorTable(colorMap);
-    maxErr = -1e20;
-    avgErr = 0.0f;
-
-    // Compute error between decoded and original data
-    for (uint32_t e=0; e<nElements; e++)
-    {
-        // Save errors
-        float err = abs(originalData[e] - decodedData[e]);
-        maxErr = max<float>(maxErr, err);
-        avgErr += err;
-        errorTextureData[e] = err;
-        if (errorFrequencies.find(errorTextureData[e]) == errorFrequencies.end())
-            errorFrequencies[errorTextureData[e]] = 1;
-        else
-            errorFrequencies[errorTextureData[e]]++;
-    }
-    avgErr /= nElements;
+    uint32_t low = 1, high = 100;
+    size_t bytes;
 
-    // Save error texture
-    for (uint32_t e=0; e<nElements; e++)
+    while (low < high)
     {
-        //uint32_t colIdx = 255.0f * (errorTextureData[e] / 65535.0f);
-        float logErr = std::log2(1.0 + (float)errorTextureData[e]) * 16.0f;
-        //logErr /= std::log(1.0 + maxErr);
-        //logErr *= 255.0;
-        errorTexture.setPixel(e % height, e / width, logErr);
+        uint32_t mid = (low + high) / 2;
+        ErrorStats estimate = EvaluateTile(params, rgb, original, tile.Width, tile.Height, mid, control.SampleStep, bytes);
+        tile.Encodes++;
+
+        if (control.Met(estimate))
+            high = mid;
+        else
+            low = mid + 1;
     }
-    errorTexture.save(QString(outPath.c_str()));
 
-    // Save error histogram
-    ofstream histogram;
-    histogram.open(outPath + "histogram.csv");
-    histogram << "Errors, Frequencies" << endl;
-    for (uint32_t i=0; i<maxErr; i++)
-        if (errorFrequencies[i] != 0)
-            histogram << i << "," << errorFrequencies[i] << endl;
+    for (tile.Quality = low; ; tile.Quality++)
+    {
+        tile.Error = EvaluateTile(params, rgb, original, tile.Width, tile.Height, tile.Quality, 1, tile.Bytes, decoded);
+        tile.Encodes++;
+        tile.Met = control.Met(tile.Error);
 
-    // Save max error and avg error
-    ofstream csv;
-    csv.open(outPath + ".txt", ios::out);
-    csv << "Max error: " << maxErr << ", avg error: " << avgErr;
-    csv.close();
+        if (tile.Met || tile.Quality == 100)
+            break;
+    }
 }
 
-uint16_t* Quantize(uint16_t* input, uint32_t nElements, uint32_t quantization)
+void RunRateControl(const string& outFolder, uint16_t* originalData, uint32_t width, uint32_t height, const vector<string>& algorithms,
+                    uint32_t quantization, const RateControl& control, bool rgbx,
+                    const ComponentScaling& scaling, const string& presetFile, uint32_t threads)
 {
-    uint16_t* ret = new uint16_t[nElements];
-    for (uint32_t i=0; i<nElements; i++)
-        ret[i] = (input[i] >> (16 - quantization)) << (16 - quantization);
-    return ret;
-}
+    uint32_t nElements = width * height;
+    ofstream tilesCsv(outFolder + "/RateControl.csv", ios::out);
+    ofstream summaryCsv(outFolder + "/RateControlSummary.csv", ios::out);
+    ThreadPool pool(threads);
 
-int main(int argc, char *argv[])
-{
-    string algorithms[6] = {"HILBERT","PACKED","MORTON","TRIANGLE","PHASE","SPLIT"};
-    uint32_t minQuality = 80, maxQuality = 100;
+    tilesCsv << "Algorithm,TileSize,X,Y,Width,Height,Quality,Bytes,Bpp,Met,Encodes,Max,Rmse" << endl;
+    summaryCsv << "Algorithm,TileSize,Tiles,TilesMet,MinQuality,MaxQuality,Bytes,Bpp,Max,Rmse,Encodes,WallNs" << endl;
 
-    string inputFile = "", outFolder = "", algo = "", outFormat = "JPG";
-    uint32_t quality = 101;
-    uint32_t quantization = 16;
-    uint32_t hilbertBits = 3;
+    // A tiled search is compared with a single quality for the whole image
+    vector<uint32_t> tileSizes = {0};
+    if (control.TileSize)
+        tileSizes.push_back(control.TileSize);
 
-    /*
-    for (uint16_t i=0; i<512; i++)
+    for (auto& algo : algorithms)
     {
-        MortonCoder mc(16, 3);
-        Color c = mc.ValueToColor(i);
-        uint16_t d = mc.ColorToValue(c);
-
-        if (d != i)
-            std::cout << "Err on " << i << ": " << abs(d - i) << endl;
-    }*/
+        CoderParams params = DefaultParams(algo, quantization);
+        params.Rgbx = rgbx;
+        SetQuantization(params, scaling, presetFile);
+        vector<uint8_t> encoded(nElements * EncodedPixelSize(params));
+        uint16_t* quantizedData = Quantize(originalData, nElements, params.Quantization);
+        EncodeData(params, quantizedData, encoded.data(), nElements);
+        delete[] quantizedData;
+
+        for (uint32_t tileSize : tileSizes)
+        {
+            uint32_t tileWidth = tileSize ? tileSize : width;
+            uint32_t tileHeight = tileSize ? tileSize : height;
+            vector<TileResult> tiles;
+            vector<uint16_t> decoded(nElements);
+            StageStats search;
 
-    uint16_t max = 8;
-    HilbertCoder hc(14, 3);
+            for (uint32_t y=0; y<height; y+=tileHeight)
+            {
+                for (uint32_t x=0; x<width; x+=tileWidth)
+                {
+                    tiles.push_back(TileResult());
+                    tiles.back().X = x;
+                    tiles.back().Y = y;
+                    tiles.back().Width = std::min(tileWidth, width - x);
+                    tiles.back().Height = std::min(tileHeight, height - y);
+                }
+            }
 
-    /*
-    for (uint16_t i=0; i<max; i++)
-    {
-        for (uint16_t j=0; j<max; j++)
-        {
-            for (uint16_t k=0; k<max; k++)
             {
-                Color col = {(uint8_t)i, (uint8_t)j, (uint8_t)k};
-                Color col2 = col;
-                hc.TransposeToHilbertCoords(col2);
-                hc.TransposeFromHilbertCoords(col2);
+                StageTimer timer(search, nElements);
+                for (auto& tile : tiles)
+                {
+                    pool.Submit([&tile, &params, &encoded, &decoded, &control, originalData, width]() {
+                        // Tiles are encoded as independent JPEGs
+                        uint32_t pixelSize = EncodedPixelSize(params);
+                        vector<uint8_t> rgb(tile.Width * tile.Height * pixelSize);
+                        vector<uint16_t> original(tile.Width * tile.Height);
+                        vector<uint16_t> tileDecoded(tile.Width * tile.Height);
+
+                        for (uint32_t y=0; y<tile.Height; y++)
+                        {
+                            uint32_t src = tile.X + (tile.Y + y) * width;
+                            std::copy(encoded.begin() + src * pixelSize, encoded.begin() + (src + tile.Width) * pixelSize,
+                                      rgb.begin() + y * tile.Width * pixelSize);
+                            std::copy(originalData + src, originalData + src + tile.Width, original.begin() + y * tile.Width);
+                        }
 
-                if (col != col2)
-                    std::cout << "Err " << (int)col.x << "," << (int)col.y << "," << (int)col.z << endl;
+                        SearchTile(params, rgb.data(), original.data(), control, tile, tileDecoded.data());
+                        for (uint32_t y=0; y<tile.Height; y++)
+                            std::copy(tileDecoded.begin() + y * tile.Width, tileDecoded.begin() + (y + 1) * tile.Width,
+                                      decoded.begin() + tile.X + (tile.Y + y) * width);
+                    });
+                }
+                pool.Wait();
             }
-        }
-    }*/
 
+            size_t bytes = 0;
+            uint32_t met = 0, encodes = 0, minQuality = 100, maxQuality = 0;
+            for (auto& tile : tiles)
+            {
+                bytes += tile.Bytes;
+                met += tile.Met;
+                encodes += tile.Encodes;
+                minQuality = std::min(minQuality, tile.Quality);
+                maxQuality = std::max(maxQuality, tile.Quality);
+                tilesCsv << algo << "," << tileSize << "," << tile.X << "," << tile.Y << "," << tile.Width << "," << tile.Height << ","
+                         << tile.Quality << "," << tile.Bytes << "," << tile.Bytes * 8.0 / (tile.Width * tile.Height) << "," << tile.Met
+                         << "," << tile.Encodes << "," << tile.Error.Max << "," << tile.Error.Rmse << endl;
+            }
 
-    for (uint16_t i=260; i<16383; i++)
-    {
-        uint16_t val = i;
-        HilbertCoder hc(14, 3);
-        Color c = hc.ValueToColor(val);
-        uint16_t d = hc.ColorToValue(c);
-
-        if (d != val)
-            cout << "Err on value " << i << ": " << abs(d - val) << endl;
+            ErrorStats total = AnalyzeError(originalData, decoded.data(), nElements, pool);
+            summaryCsv << algo << "," << tileSize << "," << tiles.size() << "," << met << "," << minQuality << "," << maxQuality << ","
+                       << bytes << "," << bytes * 8.0 / nElements << "," << total.Max << "," << total.Rmse << "," << encodes << ","
+                       << search.WallNs << endl;
+        }
     }
+}
 
-    if (ParseOptions(argc, argv, inputFile, outFolder, algo, quality, outFormat) < 0)
+int main(int argc, char *argv[])
+{
+    vector<string> algorithms = {"HILBERT","PACKED","MORTON","TRIANGLE","PHASE","SPLIT"};
+#ifdef DSTREAM_JPEG12
+    algorithms.push_back("JPEG12");
+#endif
+    uint32_t minQuality = 80, maxQuality = 100;
+
+    string inputFile = "", outFolder = "", algo = "", outFormat = "JPG";
+    uint32_t quality = 101;
+    uint32_t quantization = 16;
+    uint32_t hilbertBits = 3;
+    uint32_t previewScale = 0;
+    bool progressive = false;
+    bool multiQuality = false;
+    bool inMemory = false;
+    bool artifacts = true;
+    bool grid = false;
+    uint32_t threads = 0;
+    size_t memoryBudget = SIZE_MAX;
+    vector<uint32_t> quantizations = {10, 12, 14, 16};
+    vector<uint32_t> curveBits = {3, 4, 5, 6};
+    RateControl rateControl;
+    PostFilter postFilter;
+    DepthOutput depthOutput;
+    RawPlanes rawPlanes;
+    bool rgbx = false;
+    ChannelSplit channelSplit;
+    ComponentScaling componentScaling;
+    string presetFile = "";
+    bool arithmetic = false;
+    string huffmanFile = "";
+    vector<JpegProfile> profiles;
+
+    if (ParseOptions(argc, argv, inputFile, outFolder, algo, quality, outFormat, previewScale, progressive, multiQuality,
+                     inMemory, artifacts, grid, threads, memoryBudget, quantizations, curveBits, rateControl,
+                     postFilter, depthOutput, rawPlanes, rgbx, channelSplit,
+                     componentScaling, presetFile, arithmetic,
+                     huffmanFile, profiles) < 0)
     {
         cout << "Error parsing command line arguments.\n";
         return -1;
@@ -447,7 +1298,7 @@ int main(int argc, char *argv[])
     if (algo.compare(""))
     {
         algorithms[0] = algo;
-        for (uint32_t i=1; i<6; i++)
+        for (uint32_t i=1; i<algorithms.size(); i++)
             algorithms[i] = "";
     }
 
@@ -457,10 +1308,44 @@ int main(int argc, char *argv[])
         maxQuality = quality;
     }
 
+    if (grid && rateControl.Enabled())
+        cerr << "Warning: -g ignores the rate control options -e and -r" << endl;
+
     // Prepare output folders
     if (!outFolder.compare(""))
         outFolder = "Output";
     filesystem::create_directory(outFolder);
+
+    if (grid || rateControl.Enabled())
+    {
+        Parser parser(inputFile, InputFormat::ASC);
+        DepthmapData mapData;
+        StageStats parsing;
+        uint16_t* originalData;
+        {
+            StageTimer timer(parsing, 0, filesystem::file_size(inputFile));
+            originalData = parser.Parse(mapData);
+        }
+        parsing.Pixels = mapData.Width * mapData.Height;
+        vector<string> gridAlgorithms;
+        vector<uint32_t> qualities;
+
+        for (uint32_t i=0; i<algorithms.size(); i++)
+            if (algorithms[i].compare(""))
+                gridAlgorithms.push_back(algorithms[i]);
+        for (uint32_t q=minQuality; q<=maxQuality; q+=5)
+            qualities.push_back(q);
+
+        if (grid)
+            RunGrid(outFolder, originalData, mapData.Width, mapData.Height, gridAlgorithms, qualities, quantizations, curveBits,
+                    threads, memoryBudget, postFilter, rawPlanes, rgbx, componentScaling,
+                    presetFile, parsing);
+        else
+            RunRateControl(outFolder, originalData, mapData.Width, mapData.Height, gridAlgorithms, quantization, rateControl, rgbx,
+                           componentScaling, presetFile, threads);
+        delete[] originalData;
+        return 0;
+    }
     filesystem::create_directory(outFolder + "/Uncompressed_Decoding");
     for (uint32_t q=minQuality; q<=maxQuality; q+=5)
     {
@@ -472,12 +1357,58 @@ int main(int argc, char *argv[])
     // Prepare CSV file(s)
     ofstream uncompressedCsv;
     ofstream compressedCsv;
+    ofstream previewCsv;
+    ofstream progressiveCsv;
+    ofstream stagesCsv;
+    ofstream pngCsv;
+    ofstream entropyCsv;
+    ofstream huffmanCsv;
+    ofstream profilesCsv;
     //ofstream denoisedCsv;
 
     uncompressedCsv.open(outFolder + "/Uncompressed.csv", ios::out);
     compressedCsv.open(outFolder + "/Compressed.csv", ios::out);
+    stagesCsv.open(outFolder + "/Stages.csv", ios::out);
+    stagesCsv << "Algorithm,Quality,Bytes,Bpp,Max,Avg,Rmse,Psnr,P50,P99,P999";
+    WriteStageHeader(stagesCsv);
+    stagesCsv << endl;
+    if (previewScale)
+        previewCsv.open(outFolder + "/Preview.csv", ios::out);
+    if (!outFormat.compare("PNG"))
+    {
+        pngCsv.open(outFolder + "/Png.csv", ios::out);
+        pngCsv << "Algorithm,Filter,Level,Bytes,Bpp,WallNs,MBps" << endl;
+    }
+    if (arithmetic)
+    {
+        entropyCsv.open(outFolder + "/Entropy.csv", ios::out);
+        entropyCsv << "Algorithm,Quality,HuffmanBytes,ArithmeticBytes,Saving,HuffmanEncodeNs,ArithmeticEncodeNs,HuffmanDecodeNs,"
+                      "ArithmeticDecodeNs" << endl;
+    }
+    map<string, HuffmanTables> huffmanPresets;
+    if (huffmanFile.compare(""))
+    {
+        if (!JpegEncoder::loadHuffmanPresets(huffmanFile.c_str(), huffmanPresets))
+        {
+            cerr << "Invalid Huffman table presets " << huffmanFile << endl;
+            return -11;
+        }
+        huffmanCsv.open(outFolder + "/Huffman.csv", ios::out);
+        huffmanCsv << "Algorithm,Quality,OptimizedBytes,PretrainedBytes,StandardBytes,PretrainedOverhead,OptimizedEncodeNs,"
+                      "PretrainedEncodeNs,StandardEncodeNs" << endl;
+    }
+    if (!profiles.empty())
+    {
+        profilesCsv.open(outFolder + "/Profiles.csv", ios::out);
+        profilesCsv << "Algorithm,Quality,Profile,Bytes,EncodeNs,DecodeNs,Max,Avg,Rmse,P99,P999" << endl;
+    }
+    if (progressive)
+    {
+        progressiveCsv.open(outFolder + "/Progressive.csv", ios::out);
+        progressiveCsv << "Algorithm,Quality,Scan,Bytes,Max,Avg,Rmse" << endl;
+    }
 
-    for (uint32_t i=0; i<6; i++)
+    for (uint32_t i=0; i<algorithms.size(); i++)
     {
         if (algorithms[i].compare(""))
         {
@@ -487,7 +1418,7 @@ int main(int argc, char *argv[])
     }
     uncompressedCsv << endl;
 
-    for (uint32_t i=0; i<6; i++)
+    for (uint32_t i=0; i<algorithms.size(); i++)
     {
         if (!algorithms[i].compare(""))
             break;
@@ -495,196 +1426,486 @@ int main(int argc, char *argv[])
         {
             compressedCsv << algorithms[i] << q << "Max,";
             compressedCsv << algorithms[i] << q << "Avg,";
+            compressedCsv << algorithms[i] << q << "Bytes,";
+            if (previewScale)
+            {
+                previewCsv << algorithms[i] << q << "Max,";
+                previewCsv << algorithms[i] << q << "Avg,";
+            }
         }
     }
     compressedCsv << endl;
+    if (previewScale)
+        previewCsv << endl;
 
     // Load image
     Parser parser(inputFile, InputFormat::ASC);
     DepthmapData mapData;
-    uint16_t* originalData = parser.Parse(mapData);
+    StageStats parsing;
+    uint16_t* originalData;
+    {
+        StageTimer timer(parsing, 0, filesystem::file_size(inputFile));
+        originalData = parser.Parse(mapData);
+    }
 
     uint32_t nElements = mapData.Width * mapData.Height;
-    vector<uint8_t> encodedDataHolder(nElements * 3, 0);
+    parsing.Pixels = nElements;
+    vector<uint8_t> encodedDataHolder(nElements * (rgbx ? 4 : 3), 0);
+    vector<uint8_t> planeDataHolder(rawPlanes.Enabled ? JpegEncoder::paddedSize(mapData.Width) *
+                                    JpegEncoder::paddedSize(mapData.Height) * 3 : 0, 0);
+    vector<uint8_t> decodedPlanesHolder;
+    uint32_t planeStride = 0;
     vector<uint16_t> decodedDataHolder(nElements, 0);
     auto colorMap = LoadColorMap("error_color_map.csv");
     uint16_t* quantizedData = Quantize(originalData, mapData.Width * mapData.Height, quantization);
+    // Every error analysis of the loop shares these workers instead of starting its own
+    ThreadPool analysisPool(threads);
 
     // Benchmark said image
-    for (uint32_t a=0; a<6; a++)
+    vector<RDCurve> rdCurves;
+    for (uint32_t a=0; a<algorithms.size(); a++)
     {
-        float maxErr, avgErr;
+        ErrorStats error;
+        vector<uint32_t> histogram;
         if (!algorithms[a].compare(""))
             break;
 
         // Encode and decode uncompressed data with current algorithm
-        if (!algorithms[a].compare("MORTON"))
-        {
-            MortonCoder c(quantization, 6);
-            c.Encode(quantizedData, encodedDataHolder.data(), nElements);
-            c.Decode(encodedDataHolder.data(), decodedDataHolder.data(), nElements);
-        }
-        else if (!algorithms[a].compare("HILBERT"))
+        CoderParams params = DefaultParams(algorithms[a], quantization);
+        params.Rgbx = rgbx;
+        SetQuantization(params, componentScaling, presetFile);
+        bool jpeg12 = IsJpeg12(params);
+        // Split channels are compressed from the interleaved data, one greyscale JPEG each
+        bool splitChannels = channelSplit.Enabled && !jpeg12;
+        // With raw planes the coder writes the JPEG components directly, the interleaved data is only kept (untimed)
+        // for the uncompressed error and the PNG output
+        bool usePlanes = rawPlanes.Enabled && !jpeg12 && !splitChannels;
+        bool fusedDecode = rawPlanes.FusedDecode && !jpeg12 && !splitChannels && !postFilter.ConsistentThreshold;
+        PlaneBasis basis = usePlanes ? rawPlanes.Basis : RGB_PLANES;
+        J_COLOR_SPACE jpegColorSpace = JpegColorSpace(basis);
+        StageStats coderEncode, untimed;
         {
-            HilbertCoder c(14, 3);
-            c.Encode(quantizedData, encodedDataHolder.data(), nElements);
-            c.Decode(encodedDataHolder.data(), decodedDataHolder.data(), nElements);
+            StageTimer timer(usePlanes ? untimed : coderEncode, nElements, nElements * 2);
+            EncodeData(params, quantizedData, encodedDataHolder.data(), nElements);
         }
-        else if (!algorithms[a].compare("PACKED"))
+        if (usePlanes)
         {
-            PackedCoder c(quantization);
-            c.Encode(quantizedData, encodedDataHolder.data(), nElements);
-            c.Decode(encodedDataHolder.data(), decodedDataHolder.data(), nElements);
+            StageTimer timer(coderEncode, nElements, nElements * 2);
+            EncodeDataPlanes(params, quantizedData, mapData.Width, mapData.Height, rawPlanes.Basis, planeDataHolder);
         }
-        else if (!algorithms[a].compare("SPLIT"))
+        DecodeData(params, encodedDataHolder.data(), decodedDataHolder.data(), nElements);
+
+        error = AnalyzeError(originalData, decodedDataHolder.data(), nElements, analysisPool, &histogram);
+        if (artifacts)
         {
-            SplitCoder c(quantization);
-            c.Encode(quantizedData, encodedDataHolder.data(), nElements);
-            c.Decode(encodedDataHolder.data(), decodedDataHolder.data(), nElements);
+            SaveError(outFolder + "/Uncompressed_Decoding/error_" + algorithms[a], originalData, decodedDataHolder.data(), mapData.Width,
+                      mapData.Height, colorMap, error, histogram);
+            Writer outWriter(outFolder + "/Uncompressed_Decoding/decoded_" + algorithms[a] + ".png");
+            outWriter.Write(decodedDataHolder.data(), mapData.Width, mapData.Height, depthOutput.SixteenBit, depthOutput.CompressionLevel);
         }
-        else if (!algorithms[a].compare("PHASE"))
+        uncompressedCsv << error.Max << "," << error.Mean << ",";
+        rdCurves.push_back({algorithms[a], {}});
+
+        // Lossless storage of the encoded data: every row filter is measured, the coder's default one is saved
+        if (!outFormat.compare("PNG") && !jpeg12)
         {
-            PhaseCoder c(quantization);
-            c.Encode(quantizedData, encodedDataHolder.data(), nElements);
-            c.Decode(encodedDataHolder.data(), decodedDataHolder.data(), nElements);
+            int level = depthOutput.CompressionLevel < 0 ? 6 : depthOutput.CompressionLevel;
+            for (uint32_t f=NONE; f<=ADAPTIVE; f++)
+            {
+                PngEncoder encoder(threads);
+                vector<uint8_t> png;
+                StageStats pngEncode;
+
+                encoder.SetFilter((PngFilter)f);
+                encoder.SetCompressionLevel(level);
+                {
+                    StageTimer timer(pngEncode, nElements, nElements * 3);
+                    encoder.Encode(encodedDataHolder.data(), mapData.Width, mapData.Height, EncodedPixelSize(params), png);
+                }
+                pngCsv << algorithms[a] << "," << PngFilterName((PngFilter)f) << "," << level << "," << png.size() << ","
+                       << png.size() * 8.0 / nElements << "," << pngEncode.WallNs << "," << pngEncode.MBps() << endl;
+            }
+
+            Writer pngWriter(outFolder + "/Uncompressed_Decoding/" + algorithms[a] + "_encoded.png");
+            pngWriter.SetPngFilter(DefaultPngFilter(algorithms[a]));
+            pngWriter.SetPngCompressionLevel(level);
+            pngWriter.SetThreads(threads);
+            pngWriter.SetRgbx(params.Rgbx);
+            pngWriter.Write(encodedDataHolder.data(), mapData.Width, mapData.Height, OutputFormat::PNG);
         }
-        else if (!algorithms[a].compare("TRIANGLE"))
+
+        // Share color conversion and DCT between all the qualities of the sweep, the 12 bit path encodes each quality
+        bool sharedSweep = multiQuality && !jpeg12 && !usePlanes && !splitChannels;
+        vector<vector<uint8_t>> sweep;
+        StageStats sweepEncode;
+        if (sharedSweep)
         {
-            TriangleCoder c(quantization);
-            c.Encode(quantizedData, encodedDataHolder.data(), nElements);
-            c.Decode(encodedDataHolder.data(), decodedDataHolder.data(), nElements);
+            JpegEncoder encoder;
+            vector<int> qualities;
+            for (uint32_t q=minQuality; q<=maxQuality; q+=5)
+                qualities.push_back(q);
+
+            StageTimer timer(sweepEncode, nElements, nElements * 3);
+            if (params.Rgbx)
+                encoder.setColorSpace(J_COLOR_SPACE::JCS_EXT_RGBX, 4);
+            encoder.setJpegColorSpace(J_COLOR_SPACE::JCS_RGB);
+            ConfigureEncoder(encoder, params);
+            encoder.setProgressive(progressive);
+            encoder.encodeQualities(encodedDataHolder.data(), mapData.Width, mapData.Height, qualities, sweep);
         }
 
-
-        SaveError(outFolder + "/Uncompressed_Decoding/error_" + algorithms[a], originalData, decodedDataHolder.data(), mapData.Width,
-                  mapData.Height, colorMap, maxErr, avgErr);
-        Writer outWriter(outFolder + "/Uncompressed_Decoding/decoded_" + algorithms[a] + ".png");
-        outWriter.Write(decodedDataHolder.data(), mapData.Width, mapData.Height);
-        uncompressedCsv << maxErr << "," << avgErr << ",";
-
         for (uint32_t q=minQuality; q<=maxQuality; q+=5)
         {
             // Output file name
             stringstream ss;
             ss << outFolder << "/Compressed_Encoding_" << q << "/";
 
-            // Save in jpeg format, reload and check the error
             Writer writer(ss.str() + algorithms[a] + "_encoded.jpg");
-            writer.Write(encodedDataHolder.data(), mapData.Width, mapData.Height, OutputFormat::JPG, false, q);
+            vector<uint8_t> jpegData;
+            vector<vector<uint8_t>> channelJpegs;
+            vector<uint32_t> channelQualities = ChannelQualities(channelSplit, algorithms[a], q);
+            uint8_t* bits = nullptr;
+            // Cleared if the JPEG can't be decoded to planes
+            bool fused = fusedDecode;
+            QImage img;
+            StageStats stages[STAGE_COUNT];
+
+            stages[PARSING] = parsing;
+            stages[CODER_ENCODE] = coderEncode;
+            if (sharedSweep)
+            {
+                // The shared pass is spread evenly over the qualities it produced
+                stages[JPEG_ENCODE] = sweepEncode;
+                stages[JPEG_ENCODE].WallNs /= sweep.size();
+                stages[JPEG_ENCODE].CpuNs /= sweep.size();
+                stages[JPEG_ENCODE].Pixels /= sweep.size();
+                stages[JPEG_ENCODE].Bytes /= sweep.size();
+            }
+
+            if (inMemory)
+            {
+                // Round trip through memory buffers only
+                if (sharedSweep)
+                    jpegData.swap(sweep[(q - minQuality) / 5]);
+                else if (splitChannels)
+                {
+                    StageTimer timer(stages[JPEG_ENCODE], nElements, nElements * EncodedPixelSize(params));
+                    EncodeSplitChannels(encodedDataHolder.data(), mapData.Width, mapData.Height, EncodedPixelSize(params),
+                                        channelQualities, progressive, channelJpegs);
+                }
+                else if (usePlanes)
+                {
+                    StageTimer timer(stages[JPEG_ENCODE], nElements, nElements * 3);
+                    EncodeJpegPlanes(planeDataHolder, mapData.Width, mapData.Height, q, progressive, rawPlanes.Basis, jpegData,
+                                     params);
+                }
+                else
+                {
+                    StageTimer timer(stages[JPEG_ENCODE], nElements, nElements * EncodedPixelSize(params));
+                    EncodeJpeg(params, encodedDataHolder.data(), mapData.Width, mapData.Height, q, progressive, jpegData);
+                }
+
+                StageTimer timer(stages[JPEG_DECODE], nElements, splitChannels ? TotalSize(channelJpegs) : jpegData.size());
+                if (fused)
+                    fused = DecodeJpegPlanes(jpegData, decodedPlanesHolder, planeStride);
+                if (splitChannels)
+                {
+                    bits = new uint8_t[nElements * EncodedPixelSize(params)];
+                    DecodeSplitChannels(channelJpegs, bits, mapData.Width, mapData.Height, EncodedPixelSize(params));
+                }
+                else if (!fused)
+                    bits = DecodeJpeg(params, jpegData, basis);
+            }
+            else
+            {
+                // Save in jpeg format, reload and check the error
+                {
+                    StageTimer timer(stages[JPEG_ENCODE], sharedSweep ? 0 : nElements,
+                                     sharedSweep ? 0 : nElements * EncodedPixelSize(params));
+                    writer.SetProgressive(progressive);
+                    writer.SetRgbx(params.Rgbx);
+                    writer.SetChannelQualities(channelQualities);
+                    writer.SetComponentScales(params.ComponentScales);
+                    writer.SetBaseTables(params.QuantTables);
+                    if (sharedSweep)
+                    {
+                        const vector<uint8_t>& jpeg = sweep[(q - minQuality) / 5];
+                        writer.WriteEncoded(jpeg.data(), jpeg.size());
+                    }
+                    else if (usePlanes)
+                    {
+                        vector<uint8_t> jpeg;
+                        EncodeJpegPlanes(planeDataHolder, mapData.Width, mapData.Height, q, progressive, rawPlanes.Basis, jpeg,
+                                         params);
+                        writer.WriteEncoded(jpeg.data(), jpeg.size());
+                    }
+#ifdef DSTREAM_JPEG12
+                    else if (jpeg12)
+                        writer.WriteJpeg12((uint16_t*)encodedDataHolder.data(), mapData.Width, mapData.Height, q);
+#endif
+                    else
+                        writer.Write(encodedDataHolder.data(), mapData.Width, mapData.Height, OutputFormat::JPG, splitChannels, q);
+                }
 
-            cout << "Path: " << ss.str() + algorithms[a] + "_encoded.jpg" << endl;
+                cout << "Path: " << ss.str() + algorithms[a] + "_encoded.jpg" << endl;
+
+                if (splitChannels)
+                {
+                    channelJpegs.resize(channelQualities.size());
+                    for (uint32_t c=0; c<channelJpegs.size(); c++)
+                    {
+                        ifstream channelFile(SplitChannelPath(ss.str() + algorithms[a] + "_encoded.jpg", c), ios::binary);
+                        channelJpegs[c].assign(istreambuf_iterator<char>(channelFile), istreambuf_iterator<char>());
+                    }
+                }
+                else
+                {
+                    ifstream jpegFile(ss.str() + algorithms[a] + "_encoded.jpg", ios::binary);
+                    jpegData.assign(istreambuf_iterator<char>(jpegFile), istreambuf_iterator<char>());
+                }
 
-            QImage img(QString((ss.str() + algorithms[a] + "_encoded.jpg").c_str()));
-            img = img.convertToFormat(QImage::Format_RGB888);
-            auto bits = img.bits();
+                // Qt only reads 8 bit JPEGs and can't reassemble the split channels
+                StageTimer timer(stages[JPEG_DECODE], nElements, splitChannels ? TotalSize(channelJpegs) : jpegData.size());
+                if (fused)
+                    fused = DecodeJpegPlanes(jpegData, decodedPlanesHolder, planeStride);
+                if (splitChannels)
+                {
+                    bits = new uint8_t[nElements * EncodedPixelSize(params)];
+                    DecodeSplitChannels(channelJpegs, bits, mapData.Width, mapData.Height, EncodedPixelSize(params));
+                }
+                else if (jpeg12)
+                    bits = DecodeJpeg(params, jpegData);
+                else if (!fused)
+                {
+                    img = QImage(QString((ss.str() + algorithms[a] + "_encoded.jpg").c_str()));
+                    img = img.convertToFormat(params.Rgbx ? QImage::Format_RGBX8888 : QImage::Format_RGB888);
+                    bits = img.bits();
+                }
+            }
 
             // Decode compressed data
-            if (!algorithms[a].compare("MORTON"))
             {
-                MortonCoder c(quantization, 6);
-                c.Decode(bits, decodedDataHolder.data(), nElements);
+                StageTimer timer(stages[CODER_DECODE], nElements, nElements * 3);
+                if (fused)
+                    DecodeDataPlanes(params, decodedPlanesHolder, planeStride, basis, decodedDataHolder.data(), mapData.Width,
+                                     mapData.Height);
+                else
+                    DecodeImage(params, postFilter, bits, decodedDataHolder.data(), mapData.Width, mapData.Height);
             }
-            else if (!algorithms[a].compare("HILBERT"))
+            if (inMemory || jpeg12 || splitChannels)
+                delete[] bits;
+
+            // Remove decoding spikes
+            if (postFilter.Window)
             {
-                HilbertCoder c(14, 3);
-                c.Decode(bits, decodedDataHolder.data(), nElements);
-                // Clean data
-                //RemoveNoiseNaive(decodedDataHolder, mapData.Width, mapData.Height);
-                //RemoveNoiseMedian(decodedDataHolder, mapData.Width, mapData.Height);
+                StageTimer timer(stages[POST_FILTER], nElements, nElements * 2);
+                MedianFilter(decodedDataHolder.data(), mapData.Width, mapData.Height, postFilter.Window, postFilter.Threshold, threads);
             }
-            else if (!algorithms[a].compare("PACKED"))
+
+            // Save decoded textures
+            if (artifacts)
             {
-                PackedCoder c(quantization);
-                c.Decode(bits, decodedDataHolder.data(), nElements);
+                writer.SetPath(ss.str() + algorithms[a] + "_decoded.png");
+                writer.Write(decodedDataHolder.data(), mapData.Width, mapData.Height, depthOutput.SixteenBit,
+                             depthOutput.CompressionLevel);
             }
-            else if (!algorithms[a].compare("SPLIT"))
+
+            // Save decoded error
             {
-                SplitCoder c(quantization);
-                c.Decode(bits, decodedDataHolder.data(), nElements);
+                StageTimer timer(stages[ERROR_ANALYSIS], nElements, nElements * 4);
+                error = AnalyzeError(originalData, decodedDataHolder.data(), nElements, analysisPool, &histogram);
             }
-            else if (!algorithms[a].compare("PHASE"))
+            if (artifacts)
+                SaveError(ss.str() + algorithms[a] + "_error.png", originalData, decodedDataHolder.data(), mapData.Width, mapData.Height,
+                          colorMap, error, histogram);
+            size_t compressedBytes = inMemory ? jpegData.size() : writer.GetWrittenBytes();
+            if (inMemory && splitChannels)
+                compressedBytes = TotalSize(channelJpegs);
+            double bpp = compressedBytes * 8.0 / nElements;
+            rdCurves.back().Points.push_back({q, compressedBytes, bpp, error.Rmse, error.Psnr, error.Max});
+
+            compressedCsv << error.Max << "," << error.Mean << "," << compressedBytes << ",";
+            stagesCsv << algorithms[a] << "," << q << "," << compressedBytes << "," << bpp << ","
+                      << error.Max << "," << error.Mean << "," << error.Rmse << "," << error.Psnr << "," << error.P50 << ","
+                      << error.P99 << "," << error.P999;
+            WriteStageValues(stagesCsv, stages);
+            stagesCsv << endl;
+
+            // The same JPEG entropy coded both ways, from the interleaved data and in memory so only the coding differs
+            if (arithmetic && !jpeg12 && !splitChannels)
             {
-                PhaseCoder c(quantization);
-                c.Decode(bits, decodedDataHolder.data(), nElements);
+                CoderParams arithmeticParams = params;
+                arithmeticParams.Arithmetic = true;
+                vector<uint8_t> huffmanJpeg, arithmeticJpeg;
+                StageStats huffmanEncode, arithmeticEncode, huffmanDecode, arithmeticDecode;
+                // Entropy coding the Huffman and the arithmetic JPEG were decoded with
+                bool arithmeticCoded[2] = {false, false};
+                {
+                    StageTimer timer(huffmanEncode, nElements, nElements * EncodedPixelSize(params));
+                    EncodeJpeg(params, encodedDataHolder.data(), mapData.Width, mapData.Height, q, progressive, huffmanJpeg);
+                }
+                {
+                    StageTimer timer(arithmeticEncode, nElements, nElements * EncodedPixelSize(params));
+                    EncodeJpeg(arithmeticParams, encodedDataHolder.data(), mapData.Width, mapData.Height, q, progressive,
+                               arithmeticJpeg);
+                }
+                {
+                    StageTimer timer(huffmanDecode, nElements, huffmanJpeg.size());
+                    delete[] DecodeJpeg(params, huffmanJpeg, RGB_PLANES, &arithmeticCoded[0]);
+                }
+                {
+                    StageTimer timer(arithmeticDecode, nElements, arithmeticJpeg.size());
+                    delete[] DecodeJpeg(arithmeticParams, arithmeticJpeg, RGB_PLANES, &arithmeticCoded[1]);
+                }
+                if (arithmeticCoded[0] || !arithmeticCoded[1])
+                    cerr << "Warning: " << algorithms[a] << " q" << q << " wasn't entropy coded as requested, "
+                         << "Entropy.csv row skipped" << endl;
+                else
+                    entropyCsv << algorithms[a] << "," << q << "," << huffmanJpeg.size() << "," << arithmeticJpeg.size() << ","
+                               << 1.0 - (double)arithmeticJpeg.size() / huffmanJpeg.size() << "," << huffmanEncode.WallNs << ","
+                               << arithmeticEncode.WallNs << "," << huffmanDecode.WallNs << "," << arithmeticDecode.WallNs << endl;
             }
-            else if (!algorithms[a].compare("TRIANGLE"))
+
+            // Single pass encoding with pretrained tables against the optimization pass and the standard tables. libjpeg
+            // always optimizes progressive JPEGs.
+            string huffmanPreset = algorithms[a] + "_q" + to_string(q);
+            auto pretrained = huffmanPresets.find(huffmanPreset);
+            bool huffmanRow = huffmanFile.compare("") && !jpeg12 && !splitChannels && !progressive;
+            if (huffmanRow && pretrained == huffmanPresets.end())
+                cerr << "Warning: no Huffman preset " << huffmanPreset << " in " << huffmanFile << ", Huffman.csv row skipped"
+                     << endl;
+            else if (huffmanRow)
             {
-                TriangleCoder c(quantization);
-                c.Decode(bits, decodedDataHolder.data(), nElements);
+                CoderParams pretrainedParams = params;
+                pretrainedParams.Huffman = pretrained->second;
+                CoderParams standardParams = params;
+                standardParams.OptimizeHuffman = false;
+                vector<uint8_t> optimizedJpeg, pretrainedJpeg, standardJpeg;
+                StageStats optimizedEncode, pretrainedEncode, standardEncode;
+                {
+                    StageTimer timer(optimizedEncode, nElements, nElements * EncodedPixelSize(params));
+                    EncodeJpeg(params, encodedDataHolder.data(), mapData.Width, mapData.Height, q, false, optimizedJpeg);
+                }
+                {
+                    StageTimer timer(pretrainedEncode, nElements, nElements * EncodedPixelSize(params));
+                    EncodeJpeg(pretrainedParams, encodedDataHolder.data(), mapData.Width, mapData.Height, q, false,
+                               pretrainedJpeg);
+                }
+                {
+                    StageTimer timer(standardEncode, nElements, nElements * EncodedPixelSize(params));
+                    EncodeJpeg(standardParams, encodedDataHolder.data(), mapData.Width, mapData.Height, q, false, standardJpeg);
+                }
+                huffmanCsv << algorithms[a] << "," << q << "," << optimizedJpeg.size() << "," << pretrainedJpeg.size() << ","
+                           << standardJpeg.size() << "," << (double)pretrainedJpeg.size() / optimizedJpeg.size() - 1.0 << ","
+                           << optimizedEncode.WallNs << "," << pretrainedEncode.WallNs << "," << standardEncode.WallNs << endl;
             }
 
-            // Save decoded textures
-            writer.SetPath(ss.str() + algorithms[a] + "_decoded.png");
-            writer.Write(decodedDataHolder.data(), mapData.Width, mapData.Height);
+            // Depth error cost of the faster libjpeg settings, the whole round trip runs with each profile
+            if (!jpeg12 && !splitChannels)
+            {
+                // Kept apart from decodedDataHolder, which holds the depth decoded with the default profile
+                vector<uint16_t> profileDecoded(profiles.empty() ? 0 : nElements);
+                for (auto& profile : profiles)
+                {
+                    CoderParams profileParams = params;
+                    profileParams.Profile = profile;
+                    vector<uint8_t> profileJpeg;
+                    StageStats profileEncode, profileDecode;
+                    {
+                        StageTimer timer(profileEncode, nElements, nElements * EncodedPixelSize(params));
+                        EncodeJpeg(profileParams, encodedDataHolder.data(), mapData.Width, mapData.Height, q, progressive,
+                                   profileJpeg);
+                    }
+                    uint8_t* profileBits;
+                    {
+                        StageTimer timer(profileDecode, nElements, profileJpeg.size());
+                        profileBits = DecodeJpeg(profileParams, profileJpeg);
+                    }
+                    if (profileBits == nullptr)
+                    {
+                        cerr << "Warning: " << algorithms[a] << " q" << q << " can't be decoded with the " << profile.name
+                             << " profile, Profiles.csv row skipped" << endl;
+                        continue;
+                    }
+                    DecodeImage(params, postFilter, profileBits, profileDecoded.data(), mapData.Width, mapData.Height);
+                    delete[] profileBits;
+                    if (postFilter.Window)
+                        MedianFilter(profileDecoded.data(), mapData.Width, mapData.Height, postFilter.Window,
+                                     postFilter.Threshold, threads);
+                    ErrorStats profileError = AnalyzeError(originalData, profileDecoded.data(), nElements, analysisPool);
+                    profilesCsv << algorithms[a] << "," << q << "," << profile.name << "," << profileJpeg.size() << ","
+                                << profileEncode.WallNs << "," << profileDecode.WallNs << "," << profileError.Max << ","
+                                << profileError.Mean << "," << profileError.Rmse << "," << profileError.P99 << ","
+                                << profileError.P999 << endl;
+                }
+            }
 
-            // Save decoded error
-            SaveError(ss.str() + algorithms[a] + "_error.png", originalData, decodedDataHolder.data(), mapData.Width, mapData.Height,
-                      colorMap, maxErr, avgErr);
-            compressedCsv << maxErr << "," << avgErr << ",";
+            // Decode a reduced resolution preview using the scaled IDCT and compare it to the downsampled original
+            if (previewScale && (jpeg12 || splitChannels))
+                previewCsv << ",,";
+            else if (previewScale)
+            {
+                JpegDecoder decoder;
+                uint8_t* previewBits = nullptr;
+                int previewWidth = 0, previewHeight = 0;
+                uint32_t refWidth, refHeight;
+
+                if (params.Rgbx)
+                    decoder.setColorSpace(J_COLOR_SPACE::JCS_EXT_RGBX);
+                decoder.setJpegColorSpace(jpegColorSpace);
+                decoder.setScale(1, previewScale);
+                if (!decoder.decode(jpegData.data(), jpegData.size(), previewBits, previewWidth, previewHeight) ||
+                    previewBits == nullptr)
+                {
+                    cerr << "Warning: " << algorithms[a] << " q" << q << " preview can't be decoded, Preview.csv values skipped"
+                         << endl;
+                    previewCsv << ",,";
+                    delete[] previewBits;
+                }
+                else
+                {
+                    vector<uint16_t> reference = Downsample(originalData, mapData.Width, mapData.Height, previewScale, refWidth,
+                                                            refHeight);
+                    vector<uint16_t> preview(previewWidth * previewHeight);
+                    DecodeData(params, previewBits, preview.data(), preview.size());
+
+                    ErrorStats previewError = AnalyzeError(reference.data(), preview.data(), preview.size(), analysisPool,
+                                                           &histogram);
+                    if (artifacts)
+                        SaveError(ss.str() + algorithms[a] + "_preview_error.png", reference.data(), preview.data(), previewWidth,
+                                  previewHeight, colorMap, previewError, histogram);
+                    previewCsv << previewError.Max << "," << previewError.Mean << ",";
+                    delete[] previewBits;
+                }
+            }
+
+            // Decode every scan of the progressive JPEG and check how the error drops as more bytes arrive
+            if (progressive && !jpeg12 && !splitChannels)
+            {
+                JpegDecoder decoder;
+                int scanWidth, scanHeight;
+                uint32_t scan = 0;
+
+                if (params.Rgbx)
+                    decoder.setColorSpace(J_COLOR_SPACE::JCS_EXT_RGBX);
+                decoder.setJpegColorSpace(jpegColorSpace);
+                decoder.decodeScans(jpegData.data(), jpegData.size(), scanWidth, scanHeight, [&](uint8_t* scanBits, size_t bytesRead)
+                {
+                    DecodeData(params, scanBits, decodedDataHolder.data(), nElements);
+                    ErrorStats scanError = AnalyzeError(originalData, decodedDataHolder.data(), nElements, analysisPool);
+                    progressiveCsv << algorithms[a] << "," << q << "," << scan++ << "," << bytesRead << ","
+                                   << scanError.Max << "," << scanError.Mean << "," << scanError.Rmse << endl;
+                });
+            }
         }
     }
 
+    WriteRDCsv(outFolder + "/RD.csv", rdCurves);
+    WriteRDJson(outFolder + "/RD.json", rdCurves);
+    WriteBDRateCsv(outFolder + "/BDRate.csv", rdCurves);
+
     delete[] originalData;
     delete[] quantizedData;
 
     return 0;
 }
-
-
-#ifdef _WIN32
-
-int getopt(int nargc, char* const nargv[], const char* ostr) {
-    static const char* place = "";        // option letter processing
-    const char* oli;                      // option letter list index
-
-    if (optreset || !*place) {             // update scanning pointer
-        optreset = 0;
-        if (optind >= nargc || *(place = nargv[optind]) != '-') {
-            place = "";
-            return -1;
-        }
-
-        if (place[1] && *++place == '-') { // found "--"
-            ++optind;
-            place = "";
-            return -1;
-        }
-    }                                       // option letter okay?
-
-    if ((optopt = (int)*place++) == (int)':' || !(oli = strchr(ostr, optopt))) {
-        // if the user didn't specify '-' as an option,  assume it means -1.
-        if (optopt == (int)'-')
-            return (-1);
-        if (!*place)
-            ++optind;
-        if (opterr && *ostr != ':')
-            cout << "illegal option -- " << optopt << "\n";
-        return ('?');
-    }
-
-    if (*++oli != ':') {                    // don't need argument
-        optarg = NULL;
-        if (!*place)
-            ++optind;
-
-    }
-    else {                                // need an argument
-        if (*place)                         // no white space
-            optarg = place;
-        else if (nargc <= ++optind) {       // no arg
-            place = "";
-            if (*ostr == ':')
-                return (':');
-            if (opterr)
-                cout << "option requires an argument -- " << optopt << "\n";
-            return (':');
-        }
-        else                              // white space
-            optarg = nargv[optind];
-        place = "";
-        ++optind;
-    }
-    return optopt;                          // dump back option letter
-}
-
-#endif
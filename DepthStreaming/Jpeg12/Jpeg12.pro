@@ -0,0 +1,79 @@
+# Shared library with a 12 bit build of the bundled libjpeg-turbo (the CMake WITH_12BIT configuration: no SIMD, no
+# arithmetic coding). libjpeg is compiled with hidden symbols and only Jpeg12Codec is exported, so it can be loaded
+# next to the regular 8 bit libjpeg used by the benchmark.
+TEMPLATE = lib
+TARGET = jpeg12
+CONFIG += c++17 shared
+CONFIG -= qt
+
+DEFINES += JPEG12_LIBRARY
+
+unix {
+    QMAKE_CFLAGS += -fvisibility=hidden
+    QMAKE_CXXFLAGS += -fvisibility=hidden
+}
+
+JPEG_DIR = $$PWD/../Deps/libjpeg-turbo-2.0.6/sources
+
+# The 12 bit jconfig.h / jconfigint.h must be found before anything else. They are kept in their own folder so that
+# users of jpeg12.h don't pick them up instead of the 8 bit ones
+INCLUDEPATH += \
+    $$PWD/config \
+    $$JPEG_DIR
+
+SOURCES += \
+        $$JPEG_DIR/jcapimin.c \
+        $$JPEG_DIR/jcapistd.c \
+        $$JPEG_DIR/jccoefct.c \
+        $$JPEG_DIR/jccolor.c \
+        $$JPEG_DIR/jcdctmgr.c \
+        $$JPEG_DIR/jchuff.c \
+        $$JPEG_DIR/jcicc.c \
+        $$JPEG_DIR/jcinit.c \
+        $$JPEG_DIR/jcmainct.c \
+        $$JPEG_DIR/jcmarker.c \
+        $$JPEG_DIR/jcmaster.c \
+        $$JPEG_DIR/jcomapi.c \
+        $$JPEG_DIR/jcparam.c \
+        $$JPEG_DIR/jcphuff.c \
+        $$JPEG_DIR/jcprepct.c \
+        $$JPEG_DIR/jcsample.c \
+        $$JPEG_DIR/jctrans.c \
+        $$JPEG_DIR/jdapimin.c \
+        $$JPEG_DIR/jdapistd.c \
+        $$JPEG_DIR/jdatadst.c \
+        $$JPEG_DIR/jdatasrc.c \
+        $$JPEG_DIR/jdcoefct.c \
+        $$JPEG_DIR/jdcolor.c \
+        $$JPEG_DIR/jddctmgr.c \
+        $$JPEG_DIR/jdhuff.c \
+        $$JPEG_DIR/jdicc.c \
+        $$JPEG_DIR/jdinput.c \
+        $$JPEG_DIR/jdmainct.c \
+        $$JPEG_DIR/jdmarker.c \
+        $$JPEG_DIR/jdmaster.c \
+        $$JPEG_DIR/jdmerge.c \
+        $$JPEG_DIR/jdphuff.c \
+        $$JPEG_DIR/jdpostct.c \
+        $$JPEG_DIR/jdsample.c \
+        $$JPEG_DIR/jdtrans.c \
+        $$JPEG_DIR/jerror.c \
+        $$JPEG_DIR/jfdctflt.c \
+        $$JPEG_DIR/jfdctfst.c \
+        $$JPEG_DIR/jfdctint.c \
+        $$JPEG_DIR/jidctflt.c \
+        $$JPEG_DIR/jidctfst.c \
+        $$JPEG_DIR/jidctint.c \
+        $$JPEG_DIR/jidctred.c \
+        $$JPEG_DIR/jmemmgr.c \
+        $$JPEG_DIR/jmemnobs.c \
+        $$JPEG_DIR/jquant1.c \
+        $$JPEG_DIR/jquant2.c \
+        $$JPEG_DIR/jsimd_none.c \
+        $$JPEG_DIR/jutils.c \
+        jpeg12.cpp
+
+HEADERS += \
+    config/jconfig.h \
+    config/jconfigint.h \
+    jpeg12.h
@@ -0,0 +1,52 @@
+/* jconfigint.h for the 12 bit build of the bundled libjpeg-turbo 2.0.6, see ../Jpeg12.pro */
+
+/* libjpeg-turbo build number */
+#define BUILD  "20201116"
+
+/* Compiler's inline keyword */
+#undef inline
+
+/* How to obtain function inlining. */
+#ifdef _MSC_VER
+#define INLINE  __forceinline
+#else
+#define INLINE  __inline__ __attribute__((always_inline))
+#endif
+
+/* How to obtain thread-local storage */
+#ifdef _MSC_VER
+#define THREAD_LOCAL  __declspec(thread)
+#else
+#define THREAD_LOCAL  __thread
+#endif
+
+/* Define to the full name of this package. */
+#define PACKAGE_NAME  "libjpeg-turbo"
+
+/* Version number of package */
+#define VERSION  "2.0.6"
+
+/* The size of `size_t', as computed by sizeof. */
+#if defined(_WIN64) || defined(__LP64__)
+#define SIZEOF_SIZE_T  8
+#else
+#define SIZEOF_SIZE_T  4
+#endif
+
+/* Define if your compiler has __builtin_ctzl() and sizeof(unsigned long) == sizeof(size_t). */
+#ifndef _MSC_VER
+#define HAVE_BUILTIN_CTZL
+#endif
+
+/* Define to 1 if you have the <intrin.h> header file. */
+#ifdef _MSC_VER
+#define HAVE_INTRIN_H
+#endif
+
+#if defined(_MSC_VER) && defined(HAVE_INTRIN_H)
+#if (SIZEOF_SIZE_T == 8)
+#define HAVE_BITSCANFORWARD64
+#elif (SIZEOF_SIZE_T == 4)
+#define HAVE_BITSCANFORWARD
+#endif
+#endif
@@ -0,0 +1,98 @@
+#include "jpeg12.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+// The 12 bit config/jconfig.h comes first in the include path
+#include <jpeglib.h>
+
+static_assert(BITS_IN_JSAMPLE == 12, "Jpeg12 must be compiled against the 12 bit jconfig.h");
+
+void Jpeg12Codec::setQuality(int quality) {
+	this->quality = quality;
+}
+
+int Jpeg12Codec::getQuality() const {
+	return quality;
+}
+
+void Jpeg12Codec::setOptimize(bool optimize) {
+	this->optimize = optimize;
+}
+
+void Jpeg12Codec::setProgressive(bool progressive) {
+	this->progressive = progressive;
+}
+
+bool Jpeg12Codec::encode(const uint16_t *samples, int width, int height, std::vector<uint8_t> &dest) {
+	jpeg_compress_struct info;
+	jpeg_error_mgr errMgr;
+	unsigned char *mem = nullptr;
+	unsigned long memSize = 0;
+
+	info.err = jpeg_std_error(&errMgr);
+	jpeg_create_compress(&info);
+	jpeg_mem_dest(&info, &mem, &memSize);
+
+	info.image_width = width;
+	info.image_height = height;
+	info.in_color_space = JCS_GRAYSCALE;
+	info.input_components = 1;
+	jpeg_set_defaults(&info);
+	jpeg_set_quality(&info, quality, (boolean)true);
+	info.optimize_coding = (boolean)optimize;
+	if(progressive)
+		jpeg_simple_progression(&info);
+
+	jpeg_start_compress(&info, (boolean)true);
+	// JSAMPLE is a 16 bit short in a 12 bit build, the samples are passed as they are
+	while (info.next_scanline < info.image_height) {
+		JSAMPROW row = (JSAMPROW)(samples + (size_t)info.next_scanline * width);
+		jpeg_write_scanlines(&info, &row, 1);
+	}
+	jpeg_finish_compress(&info);
+
+	dest.assign(mem, mem + memSize);
+	jpeg_destroy_compress(&info);
+	free(mem);
+	return true;
+}
+
+bool Jpeg12Codec::encode(const uint16_t *samples, int width, int height, const char *path) {
+	std::vector<uint8_t> data;
+	if(!encode(samples, width, height, data))
+		return false;
+
+	FILE *file = fopen(path, "wb");
+	if(!file) return false;
+	bool rv = fwrite(data.data(), 1, data.size(), file) == data.size();
+	fclose(file);
+	return rv;
+}
+
+bool Jpeg12Codec::decode(const uint8_t *buffer, size_t len, std::vector<uint16_t> &samples, int &width, int &height) {
+	if (buffer == nullptr)
+		return false;
+
+	jpeg_decompress_struct info;
+	jpeg_error_mgr errMgr;
+
+	info.err = jpeg_std_error(&errMgr);
+	jpeg_create_decompress(&info);
+	jpeg_mem_src(&info, buffer, len);
+	jpeg_read_header(&info, (boolean)true);
+	info.out_color_space = JCS_GRAYSCALE;
+	jpeg_start_decompress(&info);
+
+	width = info.output_width;
+	height = info.output_height;
+	samples.resize((size_t)width * height);
+	while (info.output_scanline < info.output_height) {
+		JSAMPROW row = (JSAMPROW)(samples.data() + (size_t)info.output_scanline * width);
+		jpeg_read_scanlines(&info, &row, 1);
+	}
+
+	jpeg_finish_decompress(&info);
+	jpeg_destroy_decompress(&info);
+	return true;
+}
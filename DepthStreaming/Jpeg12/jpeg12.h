@@ -0,0 +1,37 @@
+#ifndef JPEG12_H_
+#define JPEG12_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Only this interface leaves the library: the 12 bit libjpeg inside it has the same symbols as the 8 bit one
+#if defined(_WIN32)
+	#ifdef JPEG12_LIBRARY
+		#define JPEG12_API __declspec(dllexport)
+	#else
+		#define JPEG12_API __declspec(dllimport)
+	#endif
+#else
+	#define JPEG12_API __attribute__((visibility("default")))
+#endif
+
+// Single component JPEG with 12 bit samples (0-4095), stored in the low bits of 16 bit values
+class JPEG12_API Jpeg12Codec {
+public:
+	void setQuality(int quality);
+	int getQuality() const;
+	void setOptimize(bool optimize);
+	void setProgressive(bool progressive);
+
+	bool encode(const uint16_t *samples, int width, int height, std::vector<uint8_t> &dest);
+	bool encode(const uint16_t *samples, int width, int height, const char *path);
+	bool decode(const uint8_t *buffer, size_t len, std::vector<uint16_t> &samples, int &width, int &height);
+
+private:
+	int quality = 90;
+	bool optimize = true;
+	bool progressive = false;
+};
+
+#endif // JPEG12_H_
@@ -0,0 +1,47 @@
+CONFIG += c++17 console
+CONFIG -= app_bundle
+QT -= gui
+
+win32:LIBS += \
+    $$PWD/../Deps/libjpeg-turbo-2.0.6/bin/jpeg62.dll
+unix:LIBS += -ljpeg
+
+win32:INCLUDEPATH += \
+    $$PWD/../Deps/libjpeg-turbo-2.0.6/include
+
+# Coders, parser and JPEG wrappers are compiled straight from the benchmark sources
+INCLUDEPATH += \
+    $$PWD/../DepthStreaming
+
+SOURCES += \
+        ../DepthStreaming/ErrorAnalysis.cpp \
+        ../DepthStreaming/HilbertCoder.cpp \
+        ../DepthStreaming/MortonCoder.cpp \
+        ../DepthStreaming/PackedCoder.cpp \
+        ../DepthStreaming/Parser.cpp \
+        ../DepthStreaming/PhaseCoder.cpp \
+        ../DepthStreaming/SplitCoder.cpp \
+        ../DepthStreaming/ThreadPool.cpp \
+        ../DepthStreaming/TriangleCoder.cpp \
+        ../DepthStreaming/jpeg_decoder.cpp \
+        ../DepthStreaming/jpeg_encoder.cpp \
+        main.cpp
+
+HEADERS += \
+    ../DepthStreaming/Algorithm.h \
+    ../DepthStreaming/CoderDispatch.h \
+    ../DepthStreaming/ErrorAnalysis.h \
+    ../DepthStreaming/GetOpt.h \
+    ../DepthStreaming/HilbertCoder.h \
+    ../DepthStreaming/MortonCoder.h \
+    ../DepthStreaming/PackedCoder.h \
+    ../DepthStreaming/Parser.h \
+    ../DepthStreaming/PhaseCoder.h \
+    ../DepthStreaming/RgbxLayout.h \
+    ../DepthStreaming/SplitCoder.h \
+    ../DepthStreaming/ThreadPool.h \
+    ../DepthStreaming/TriangleCoder.h \
+    ../DepthStreaming/Vec3.h \
+    ../DepthStreaming/jpeg_decoder.h \
+    ../DepthStreaming/jpeg_encoder.h \
+    ../DepthStreaming/jpeg_profile.h
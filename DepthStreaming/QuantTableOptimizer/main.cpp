@@ -0,0 +1,421 @@
+#include <Parser.h>
+#include <HilbertCoder.h>
+#include <MortonCoder.h>
+#include <SplitCoder.h>
+#include <PhaseCoder.h>
+#include <TriangleCoder.h>
+#include <PackedCoder.h>
+#include <jpeg_encoder.h>
+#include <jpeg_decoder.h>
+#include <ThreadPool.h>
+#include <ErrorAnalysis.h>
+#include <CoderDispatch.h>
+#include <GetOpt.h>
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+using namespace DStream;
+using namespace std;
+
+/** Offline search of the JPEG quantization tables of a coder over a training set of DEMs.
+ *  - the 64 steps of each component are grouped in the 15 anti-diagonals (u + v) of the 8x8 block, each band has its
+ *    own multiplier on the IJG luminance table
+ *  - for a set of multipliers, the overall scale is bisected to the coarsest one that still meets the depth error
+ *    target on every DEM, and the tables are ranked by the bytes they then take
+ *  - each round tries doubling and halving every band in parallel (in-memory round trips only) and keeps the
+ *    improvements, the step is narrowed when a round finds none
+ *
+ *  The learned tables are saved as a JpegEncoder preset, named after the coder by default. They are the tables of
+ *  quality 50: the benchmark loads them with -P and scales them with the tested quality like the IJG ones.
+ *
+ *  With -H the Huffman tables of single pass encoding are trained instead: the optimal tables of every DEM at a quality
+ *  are merged and saved as the preset <name>_q<quality>, loaded by the benchmark with -H.
+ *
+ *  The DEMs are encoded the way the benchmark encodes the interleaved coder output (RGB JPEG, no chroma subsampling),
+ *  with the component scales of -k if given, so the tables match a benchmark run with the same -k.
+ */
+
+void Usage()
+{
+    cerr <<
+    R"use(Usage: quanttableoptimizer [OPTIONS] <FILE> [FILE...]
+
+    Learns the JPEG quantization tables, or the Huffman tables, of a coder from one or more ASC DEMs
+      -a <algorithm>: coder (PACKED,TRIANGLE,MORTON,HILBERT,PHASE,SPLIT), defaults to PACKED
+      -q <quantization>: coder quantization, defaults to the benchmark one (14 for HILBERT, 16 otherwise)
+      -c <bits>: curve bits of HILBERT and MORTON, defaults to the benchmark ones (3 and 6)
+      -e <error>: max depth error the tables must meet on every DEM
+      -r <rmse>: depth RMSE the tables must meet on every DEM
+      -s <size>: train on a centred <size>x<size> crop of each DEM, 0 for the whole DEM (default 512)
+      -l <levels>: number of search steps, from doubling a band to 2^(1/2^(levels-1)) (default 3)
+      -t <threads>: number of worker threads, defaults to the number of cores
+      -o <file>: preset file the tables are saved to (default quant_tables.txt), other presets in it are kept
+      -n <name>: preset name, defaults to the coder name
+      -H <qualities>: train the Huffman tables of the comma separated JPEG qualities instead, saved as <name>_q<quality>.
+         The quantization preset <name> of the file is used if there is one. No error target is needed.
+      -k[scales]: train with the JPEG component scales of the benchmark's -k, the coder preset or the comma separated
+         scales. The tables only match benchmark runs with the same -k: the DEMs are encoded as interleaved RGB JPEGs,
+         like the benchmark's -H comparison and its default path.
+      -?: display this message
+
+    )use";
+}
+
+// The IJG luminance table (Annex K of the JPEG standard), in natural order
+const uint16_t BaseTable[64] = {
+    16,  11,  10,  16,  24,  40,  51,  61,
+    12,  12,  14,  19,  26,  58,  60,  55,
+    14,  13,  16,  24,  40,  57,  69,  56,
+    14,  17,  22,  29,  51,  87,  80,  62,
+    18,  22,  37,  56,  68, 109, 103,  77,
+    24,  35,  55,  64,  81, 104, 113,  92,
+    49,  64,  78,  87, 103, 121, 120, 101,
+    72,  92,  95,  98, 112, 100, 103,  99
+};
+
+const uint32_t COMPONENTS = 3;
+const uint32_t BANDS = 15;
+// Bisection steps of the overall scale, searched between 2^-6 and 2^4
+const uint32_t SCALE_STEPS = 8;
+
+struct Config
+{
+    string Algorithm = "PACKED";
+    uint32_t Quantization = 0;
+    uint32_t CurveBits = 0;
+    float MaxErr = 0.0f;
+    float Rmse = 0.0f;
+    // JPEG component scales, empty for the plain tables
+    vector<float> ComponentScales;
+};
+
+struct TrainingDem
+{
+    uint32_t Width, Height;
+    vector<uint16_t> Original;
+    vector<uint8_t> Encoded;
+};
+
+// Band multipliers and the bytes taken by the training set at their best scale
+struct Candidate
+{
+    vector<float> Bands;
+    float Scale = 1.0f;
+    size_t Bytes = SIZE_MAX;
+};
+
+template <typename F>
+void WithCoder(const Config& config, F f)
+{
+    DStream::WithCoder(config.Algorithm, config.Quantization, config.CurveBits, f);
+}
+
+bool LoadDem(const Config& config, const string& path, uint32_t cropSize, TrainingDem& dem)
+{
+    Parser parser(path, InputFormat::ASC);
+    DepthmapData mapData;
+    uint16_t* data = parser.Parse(mapData);
+    if (data == nullptr)
+        return false;
+
+    dem.Width = cropSize ? std::min(cropSize, mapData.Width) : mapData.Width;
+    dem.Height = cropSize ? std::min(cropSize, mapData.Height) : mapData.Height;
+    uint32_t x0 = (mapData.Width - dem.Width) / 2, y0 = (mapData.Height - dem.Height) / 2;
+    uint32_t nElements = dem.Width * dem.Height;
+
+    dem.Original.resize(nElements);
+    for (uint32_t y=0; y<dem.Height; y++)
+        for (uint32_t x=0; x<dem.Width; x++)
+            dem.Original[x + y * dem.Width] = data[x0 + x + (y0 + y) * mapData.Width];
+    delete[] data;
+
+    // Coder input quantized the same way as in the benchmark
+    vector<uint16_t> quantized(nElements);
+    for (uint32_t i=0; i<nElements; i++)
+        quantized[i] = (dem.Original[i] >> (16 - config.Quantization)) << (16 - config.Quantization);
+    dem.Encoded.resize(nElements * 3);
+    WithCoder(config, [&](auto& coder) { coder.Encode(quantized.data(), dem.Encoded.data(), nElements); });
+    return true;
+}
+
+vector<vector<uint16_t>> BuildTables(const vector<float>& bands, float scale)
+{
+    vector<vector<uint16_t>> ret(COMPONENTS, vector<uint16_t>(64));
+    for (uint32_t c=0; c<COMPONENTS; c++)
+        for (uint32_t k=0; k<64; k++)
+        {
+            float step = BaseTable[k] * bands[c * BANDS + k / 8 + k % 8] * scale;
+            ret[c][k] = std::min(255L, std::max(1L, std::lround(step)));
+        }
+    return ret;
+}
+
+// Bytes of the whole training set at quality 50 (the tables as they are), SIZE_MAX if a DEM misses the target
+size_t Evaluate(const Config& config, const vector<TrainingDem>& dems, const vector<vector<uint16_t>>& tables)
+{
+    size_t bytes = 0;
+    for (auto& dem : dems)
+    {
+        JpegEncoder encoder;
+        JpegDecoder decoder;
+        uint8_t* jpeg = nullptr;
+        uint8_t* decodedColors = nullptr;
+        int length = 0, width, height;
+        uint32_t nElements = dem.Width * dem.Height;
+        vector<uint16_t> decoded(nElements);
+
+        encoder.setJpegColorSpace(J_COLOR_SPACE::JCS_RGB);
+        encoder.setQuality(50);
+        encoder.setBaseTables(tables);
+        encoder.setComponentScales(config.ComponentScales);
+        encoder.encode((uint8_t*)dem.Encoded.data(), dem.Width, dem.Height, jpeg, length);
+
+        decoder.setJpegColorSpace(J_COLOR_SPACE::JCS_RGB);
+        decoder.decode(jpeg, length, decodedColors, width, height);
+        free(jpeg);
+        WithCoder(config, [&](auto& coder) { coder.Decode(decodedColors, decoded.data(), nElements); });
+        delete[] decodedColors;
+
+        ErrorStats error = AnalyzeError(dem.Original.data(), decoded.data(), nElements, 1);
+        if ((config.MaxErr > 0.0f && error.Max > config.MaxErr) || (config.Rmse > 0.0f && error.Rmse > config.Rmse))
+            return SIZE_MAX;
+        bytes += length;
+    }
+    return bytes;
+}
+
+// Coarsest overall scale of the band multipliers meeting the target, bisected in the log domain
+void Fit(const Config& config, const vector<TrainingDem>& dems, Candidate& candidate)
+{
+    float lo = -6.0f, hi = 4.0f;
+
+    candidate.Bytes = Evaluate(config, dems, BuildTables(candidate.Bands, std::exp2(lo)));
+    candidate.Scale = std::exp2(lo);
+    if (candidate.Bytes == SIZE_MAX)
+        return;
+
+    for (uint32_t i=0; i<SCALE_STEPS; i++)
+    {
+        float mid = (lo + hi) / 2.0f;
+        size_t bytes = Evaluate(config, dems, BuildTables(candidate.Bands, std::exp2(mid)));
+        if (bytes == SIZE_MAX)
+            hi = mid;
+        else
+        {
+            lo = mid;
+            candidate.Scale = std::exp2(mid);
+            candidate.Bytes = bytes;
+        }
+    }
+}
+
+void FitAll(const Config& config, const vector<TrainingDem>& dems, vector<Candidate>& candidates, ThreadPool& pool)
+{
+    for (auto& candidate : candidates)
+        pool.Submit([&config, &dems, &candidate]() { Fit(config, dems, candidate); });
+    pool.Wait();
+}
+
+// JPEG of the coder output at the given quality and tables, empty Huffman tables run the optimization pass
+size_t EncodeDem(const Config& config, const TrainingDem& dem, uint32_t quality,
+                 const vector<vector<uint16_t>>& quantTables, const HuffmanTables& huffmanTables,
+                 HuffmanTables* usedTables = nullptr)
+{
+    JpegEncoder encoder;
+    uint8_t* jpeg = nullptr;
+    int length = 0;
+
+    encoder.setJpegColorSpace(J_COLOR_SPACE::JCS_RGB);
+    encoder.setQuality(quality);
+    encoder.setBaseTables(quantTables);
+    encoder.setComponentScales(config.ComponentScales);
+    encoder.setHuffmanTables(huffmanTables);
+    encoder.encode((uint8_t*)dem.Encoded.data(), dem.Width, dem.Height, jpeg, length);
+    free(jpeg);
+
+    if (usedTables)
+        *usedTables = encoder.getHuffmanTables();
+    return length;
+}
+
+int TrainHuffman(const Config& config, const vector<TrainingDem>& dems, const vector<uint32_t>& qualities,
+                 const string& outFile, const string& presetName)
+{
+    vector<vector<uint16_t>> quantTables;
+    if (JpegEncoder::loadPresetTables(outFile.c_str(), presetName.c_str(), quantTables))
+        cout << "Using the quantization preset " << presetName << endl;
+
+    for (uint32_t quality : qualities)
+    {
+        vector<HuffmanTables> sets(dems.size());
+        size_t optimizedBytes = 0, pretrainedBytes = 0;
+
+        for (uint32_t i=0; i<dems.size(); i++)
+            optimizedBytes += EncodeDem(config, dems[i], quality, quantTables, HuffmanTables(), &sets[i]);
+        HuffmanTables merged = JpegEncoder::mergeHuffmanTables(sets);
+        for (auto& dem : dems)
+            pretrainedBytes += EncodeDem(config, dem, quality, quantTables, merged);
+
+        string name = presetName + "_q" + to_string(quality);
+        if (!JpegEncoder::saveHuffmanPreset(outFile.c_str(), name.c_str(), merged))
+        {
+            cerr << "Failed writing " << outFile << endl;
+            return -5;
+        }
+        cout << "Quality " << quality << ": " << optimizedBytes << " bytes optimized, " << pretrainedBytes
+             << " bytes with the pretrained tables (" << 100.0 * pretrainedBytes / optimizedBytes << "%), saved as "
+             << name << endl;
+    }
+
+    return 0;
+}
+
+void PrintTables(const vector<vector<uint16_t>>& tables)
+{
+    for (uint32_t c=0; c<tables.size(); c++)
+    {
+        cout << "Component " << c << ":" << endl;
+        for (uint32_t y=0; y<8; y++)
+        {
+            for (uint32_t x=0; x<8; x++)
+                cout << " " << tables[c][x + y * 8];
+            cout << endl;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Config config;
+    uint32_t cropSize = 512, levels = 3, threads = 0;
+    string outFile = "quant_tables.txt", presetName = "";
+    vector<uint32_t> huffmanQualities;
+    bool componentScaling = false;
+    int c;
+
+    while ((c = getopt(argc, argv, "a:q:c:e:r:s:l:t:o:n:H:k::")) != -1) {
+        switch (c) {
+        case 'a': config.Algorithm = optarg; break;
+        case 'q': config.Quantization = atoi(optarg); break;
+        case 'c': config.CurveBits = atoi(optarg); break;
+        case 'e': config.MaxErr = atof(optarg); break;
+        case 'r': config.Rmse = atof(optarg); break;
+        case 's': cropSize = atoi(optarg); break;
+        case 'l': levels = std::max(1, atoi(optarg)); break;
+        case 't': threads = atoi(optarg); break;
+        case 'o': outFile = optarg; break;
+        case 'n': presetName = optarg; break;
+        case 'H': huffmanQualities = ParseList(optarg); break;
+        case 'k':
+        {
+            componentScaling = true;
+            stringstream ss(optarg ? optarg : "");
+            string item;
+            while (getline(ss, item, ','))
+                config.ComponentScales.push_back(atof(item.c_str()));
+            break;
+        }
+        default: Usage(); return -1;
+        }
+    }
+
+    if (optind == argc || (config.MaxErr <= 0.0f && config.Rmse <= 0.0f && huffmanQualities.empty()))
+    {
+        cerr << "Missing DEMs or error target" << endl;
+        Usage();
+        return -2;
+    }
+
+    // Same coder parameters as the serial benchmark unless given
+    bool hilbert = !config.Algorithm.compare("HILBERT");
+    if (!config.Quantization)
+        config.Quantization = hilbert ? 14 : 16;
+    if (!config.CurveBits)
+        config.CurveBits = hilbert ? 3 : 6;
+    if (!presetName.compare(""))
+        presetName = config.Algorithm;
+    if (componentScaling && config.ComponentScales.empty())
+        config.ComponentScales = ComponentScalePreset(config.Algorithm);
+
+    vector<TrainingDem> dems(argc - optind);
+    for (uint32_t i=0; i<dems.size(); i++)
+    {
+        if (!LoadDem(config, argv[optind + i], cropSize, dems[i]))
+            return -3;
+    }
+    if (!huffmanQualities.empty())
+        return TrainHuffman(config, dems, huffmanQualities, outFile, presetName);
+
+    ThreadPool pool(threads);
+    vector<Candidate> baseline(1);
+    baseline[0].Bands.assign(COMPONENTS * BANDS, 1.0f);
+    FitAll(config, dems, baseline, pool);
+    if (baseline[0].Bytes == SIZE_MAX)
+    {
+        cerr << "The error target can't be met even with the finest tables" << endl;
+        return -4;
+    }
+    cout << "IJG tables: " << baseline[0].Bytes << " bytes at scale " << baseline[0].Scale << endl;
+
+    Candidate best = baseline[0];
+    float step = 2.0f;
+    for (uint32_t level=0; level<levels; level++, step = std::sqrt(step))
+    {
+        while (true)
+        {
+            // Every band made coarser and finer
+            vector<Candidate> candidates;
+            for (uint32_t b=0; b<best.Bands.size(); b++)
+            {
+                for (float factor : {step, 1.0f / step})
+                {
+                    Candidate candidate = best;
+                    candidate.Bands[b] = std::min(64.0f, std::max(1.0f / 64.0f, best.Bands[b] * factor));
+                    if (candidate.Bands[b] != best.Bands[b])
+                        candidates.push_back(candidate);
+                }
+            }
+            FitAll(config, dems, candidates, pool);
+
+            // All the improving moves together, or the best one alone if they don't add up
+            vector<Candidate> combined(1, best);
+            Candidate* bestMove = nullptr;
+            for (auto& candidate : candidates)
+            {
+                if (candidate.Bytes >= best.Bytes)
+                    continue;
+                if (bestMove == nullptr || candidate.Bytes < bestMove->Bytes)
+                    bestMove = &candidate;
+                for (uint32_t b=0; b<best.Bands.size(); b++)
+                    if (candidate.Bands[b] != best.Bands[b])
+                        combined[0].Bands[b] = candidate.Bands[b];
+            }
+            if (bestMove == nullptr)
+                break;
+
+            FitAll(config, dems, combined, pool);
+            best = combined[0].Bytes < bestMove->Bytes ? combined[0] : *bestMove;
+            cout << "Step " << step << ": " << best.Bytes << " bytes at scale " << best.Scale << " ("
+                 << 100.0 * best.Bytes / baseline[0].Bytes << "% of the IJG tables)" << endl;
+        }
+    }
+
+    vector<vector<uint16_t>> tables = BuildTables(best.Bands, best.Scale);
+    PrintTables(tables);
+    if (!JpegEncoder::savePreset(outFile.c_str(), presetName.c_str(), tables))
+    {
+        cerr << "Failed writing " << outFile << endl;
+        return -5;
+    }
+    cout << "Saved preset " << presetName << " to " << outFile << endl;
+
+    return 0;
+}
+